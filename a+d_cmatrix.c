@@ -10,6 +10,10 @@
 	#define COUPLING_MATRIX_FILE_FORMAT "cmatrix_arrang=%c_n=%zu_J=%zu.bin"
 #endif
 
+#if !defined(COUPLING_DIAG_FILE_FORMAT)
+	#define COUPLING_DIAG_FILE_FORMAT "cdiag_arrang=%c_J=%zu.bin"
+#endif
+
 struct tasks
 {
 	size_t a, b;
@@ -66,16 +70,43 @@ double simpson(const size_t grid_size,
 	return 3.0*grid_step*sum/8.0;
 }
 
+/******************************************************************************
+
+ Function quadrature(): the same as simpson() but for a non-uniform grid, where
+ the respective quadrature weights are given.
+
+******************************************************************************/
+
+double quadrature(const size_t grid_size,
+                  const double weight[],
+                  const double potential[],
+                  const double wavef_a[],
+                  const double wavef_b[])
+{
+	double sum = 0.0;
+	for (size_t n = 0; n < grid_size; ++n)
+		sum += weight[n]*potential[n]*wavef_a[n]*wavef_b[n];
+
+	return sum;
+}
+
 /******************************************************************************
 
  Function integral(): computes the matrix element <a|m|b> for all lambda values
- and a given total angular momentum, J, using a 3/8-Simpson quadrature rule.
+ and a given total angular momentum, J, using a 3/8-Simpson quadrature rule, or
+ the basis quadrature weights if a non-uniform grid (r_step = 0) is used.
+
+ NOTE: in the coupled-states approximation the Percival-Seaton term is replaced
+ by the Gaunt coefficient of the body-fixed helicity, which is conserved. Thus,
+ the coupling matrix is block diagonal in omega.
 
 ******************************************************************************/
 
-double integral(const size_t J,
+double integral(const size_t J, const bool coupled_states,
                 const pes_multipole *m, const fgh_basis *a, const fgh_basis *b)
 {
+	if (coupled_states && a->omega != b->omega) return 0.0;
+
 	ASSERT(a->r_step == b->r_step)
 	ASSERT(b->r_step == m->r_step)
 
@@ -87,13 +118,23 @@ double integral(const size_t J,
 	{
 		ASSERT(m->value[lambda] != NULL)
 
-		const double f
-			= math_percival_seaton(J, a->j, b->j, a->l, b->l, lambda);
+		const double f = (coupled_states?
+			math_gaunt(a->omega, a->j, b->j, lambda) :
+			math_percival_seaton(J, a->j, b->j, a->l, b->l, lambda));
 
 		if (f == 0.0) continue;
 
-		const double v
-			= simpson(m->grid_size, m->r_step, m->value[lambda], a->eigenvec, b->eigenvec);
+		double v = 0.0;
+
+		if (m->r_step == 0.0)
+		{
+			ASSERT(a->weight != NULL)
+			v = quadrature(m->grid_size, a->weight, m->value[lambda], a->eigenvec, b->eigenvec);
+		}
+		else
+		{
+			v = simpson(m->grid_size, m->r_step, m->value[lambda], a->eigenvec, b->eigenvec);
+		}
 
 		result += v*f;
 	}
@@ -107,15 +148,16 @@ double integral(const size_t J,
 
 ******************************************************************************/
 
-double driver(const double mass, const size_t J, const size_t max_task,
-              const struct tasks job[], const pes_multipole *m, matrix *c, const bool use_omp)
+double driver(const double mass, const size_t J, const bool coupled_states,
+              const size_t max_task, const struct tasks job[],
+              const pes_multipole *m, matrix *c, const bool use_omp)
 {
 	const double start_time = wall_time();
 
-	#pragma omp parallel for default(none) shared(job, m, c) schedule(static) if(use_omp)
+	#pragma omp parallel for default(none) shared(job, m, c) firstprivate(mass, J, coupled_states, max_task) schedule(static) if(use_omp)
 	for (size_t task = 0; task < max_task; ++task)
 	{
-		double result = integral(J, m, job[task].basis_a, job[task].basis_b);
+		double result = integral(J, coupled_states, m, job[task].basis_a, job[task].basis_b);
 
 		if (job[task].a == job[task].b)
 		{
@@ -135,6 +177,55 @@ double driver(const double mass, const size_t J, const size_t max_task,
 	return (end_time - start_time);
 }
 
+/******************************************************************************
+
+ Function save_diag(): gathers in the MPI process 0 the diagonal of the coupling
+ matrices of all grid_size grid points, diag[n*max_channel + c], each process
+ having set only the ones of its own grid points (the others being zero), and
+ saves it in a single file for a given arrangement and J. Thus, numerov finds
+ the starting point of each energy (wkb_depth) without reading every coupling
+ matrix twice.
+
+******************************************************************************/
+
+void save_diag(const char arrang,
+               const size_t J,
+               const size_t grid_size,
+               const size_t max_channel,
+               double diag[])
+{
+	const size_t length = grid_size*max_channel;
+
+	if (mpi_rank() > 0)
+	{
+		mpi_send(0, length, 'd', diag);
+		return;
+	}
+
+	double *buffer = allocate(length, sizeof(double), false);
+
+	for (size_t from = 1; from < mpi_comm_size(); ++from)
+	{
+		mpi_receive(from, length, 'd', buffer);
+
+		for (size_t n = 0; n < length; ++n)
+			diag[n] += buffer[n];
+	}
+
+	free(buffer);
+
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, COUPLING_DIAG_FILE_FORMAT, arrang, J);
+
+	FILE *output = file_open(filename, "wb");
+
+	file_write(&grid_size, sizeof(size_t), 1, output);
+	file_write(&max_channel, sizeof(size_t), 1, output);
+	file_write(diag, sizeof(double), length, output);
+
+	file_close(&output);
+}
+
 /******************************************************************************
 ******************************************************************************/
 
@@ -166,6 +257,12 @@ int main(int argc, char *argv[])
 
 	const size_t J_step = read_int_keyword(stdin, "J_step", 1, 10000, 1);
 
+/*
+ *	Coupled-states approximation (the basis must be built likewise):
+ */
+
+	const bool coupled_states = (bool) read_int_keyword(stdin, "coupled_states", 0, 1, 0);
+
 /*
  * Directory to read all basis functions and multipoles from:
  */
@@ -183,7 +280,19 @@ int main(int argc, char *argv[])
 
 	ASSERT(scatt_grid_size > 0)
 
-	mpi_set_tasks(scatt_grid_size);
+/*
+ *	If cmatrix_stride > 1 (even), only the midpoints of sectors of cmatrix_stride
+ *	grid steps, n = cmatrix_stride/2, 3*cmatrix_stride/2, ..., are computed, as
+ *	needed by logd_sector with sector_stride = cmatrix_stride:
+ */
+
+	const size_t stride = read_int_keyword(stdin, "cmatrix_stride", 1, scatt_grid_size, 1);
+
+	ASSERT(stride == 1 || stride%2 == 0)
+
+	const size_t max_point = (scatt_grid_size - stride/2 + stride - 1)/stride;
+
+	mpi_set_tasks(max_point);
 
 	if (mpi_rank())
 	{
@@ -218,15 +327,21 @@ int main(int argc, char *argv[])
 
 		const bool use_omp = read_int_keyword(stdin, "use_omp", 0, 1, 0);
 
-		const size_t max_task = max_channel*(max_channel + 1)/2;
+		const size_t max_pair = max_channel*(max_channel + 1)/2;
 
-		struct tasks *list = allocate(max_task, sizeof(struct tasks), true);
+		struct tasks *list = allocate(max_pair, sizeof(struct tasks), true);
 
 		size_t counter = 0;
 		for (size_t n = 0; n < max_channel; ++n)
 		{
 			for (size_t m = n; m < max_channel; ++m)
 			{
+/*
+ *				NOTE: in the CS approximation only pairs of the same omega block
+ *				are coupled, the remaining elements are zero.
+ */
+				if (coupled_states && basis[n].omega != basis[m].omega) continue;
+
 				list[counter].a = n;
 				list[counter].basis_a = &basis[n];
 
@@ -237,7 +352,9 @@ int main(int argc, char *argv[])
 			}
 		}
 
-		ASSERT(counter == max_task)
+		ASSERT(counter <= max_pair)
+
+		const size_t max_task = counter;
 
 /*
  *		Resolve all tasks:
@@ -246,35 +363,56 @@ int main(int argc, char *argv[])
 		pes_multipole m;
 		matrix *c = matrix_alloc(max_channel, max_channel, false);
 
-		for (size_t n = mpi_first_task(); n <= mpi_last_task(); ++n)
+		double *diag = allocate(scatt_grid_size*max_channel, sizeof(double), true);
+
+		for (size_t p = mpi_first_task(); p <= mpi_last_task(); ++p)
 		{
 			extra_step:
-			matrix_set_zero(c);
-			pes_multipole_load(&m, m_dir, arrang, n);
+			{
+				const size_t n = p*stride + stride/2;
+
+				matrix_set_zero(c);
+				pes_multipole_load(&m, m_dir, arrang, n);
 
-			const double wtime = driver(mass, J, max_task, list, &m, c, use_omp);
+				const double wtime = driver(mass, J, coupled_states, max_task, list, &m, c, use_omp);
 
-			char filename[MAX_LINE_LENGTH];
-			sprintf(filename, COUPLING_MATRIX_FILE_FORMAT, arrang, n, J);
+				char filename[MAX_LINE_LENGTH];
+				sprintf(filename, COUPLING_MATRIX_FILE_FORMAT, arrang, n, J);
 
-			matrix_save(c, filename);
+				matrix_save(c, filename);
 
-			printf("  %4zu   %4zu   %4zu      %06f      %f\n", mpi_rank(), J, max_channel, m.R, wtime);
+				for (size_t i = 0; i < max_channel; ++i)
+					diag[n*max_channel + i] = matrix_get(c, i, i);
 
-			pes_multipole_free(&m);
+				printf("  %4zu   %4zu   %4zu      %06f      %f\n", mpi_rank(), J, max_channel, m.R, wtime);
 
-			if (n == mpi_last_task() && mpi_extra_task() > 0)
+				pes_multipole_free(&m);
+			}
+
+			if (p == mpi_last_task() && mpi_extra_task() > 0)
 			{
-				n = mpi_extra_task();
+				p = mpi_extra_task();
 				goto extra_step;
 			}
 		}
 
+/*
+ *		NOTE: the diagonal is only saved if all grid points are computed, as
+ *		needed by numerov, see save_diag().
+ */
+
+		if (stride == 1) save_diag(arrang, J, scatt_grid_size, max_channel, diag);
+
 		matrix_free(c);
+		free(diag);
 		free(list);
 
 		for (size_t n = 0; n < max_channel; ++n)
+		{
 			if (basis[n].eigenvec != NULL) free(basis[n].eigenvec);
+			if (basis[n].weight != NULL) free(basis[n].weight);
+			if (basis[n].r != NULL) free(basis[n].r);
+		}
 
 		free(basis);
 	}
@@ -29,9 +29,9 @@ inline static int parity(const size_t l)
 
 ******************************************************************************/
 
-void print_level(const fgh_basis *b, const size_t ch, const size_t J)
+void print_level(FILE *output, const fgh_basis *b, const size_t ch, const size_t J)
 {
-	printf(FORMAT, J, ch, b->v, b->j, b->l, parity(b->j + b->l), b->n,
+	fprintf(output, FORMAT, J, ch, b->v, b->j, b->l, parity(b->j + b->l), b->n,
 	       b->eigenval, b->eigenval*219474.63137054, b->eigenval*27.211385);
 }
 
@@ -140,6 +140,28 @@ int main(int argc, char *argv[])
 
 	char *dir = read_str_keyword(stdin, "basis_dir", ".");
 
+/*
+ *	Energy cutoff: only channels whose asymptotic level is below E_max + E_margin
+ *	are kept, the others are listed in the basis dir. as dropped channels:
+ */
+
+	const bool energy_cutoff = (bool) read_int_keyword(stdin, "energy_cutoff", 0, 1, 0);
+
+	const double E_max = read_dbl_keyword(stdin, "E_max", -INF, INF, INF);
+
+	const double E_margin = read_dbl_keyword(stdin, "E_margin", 0.0, INF, 0.0);
+
+	const double cutoff = (energy_cutoff? E_max + E_margin : INF);
+
+	FILE *dropped = NULL;
+
+	if (energy_cutoff)
+	{
+		dropped = fgh_dropped_file(dir, arrang, "w");
+
+		fprintf(dropped, "# Channels above the energy cutoff = % -8e a.u.\n", cutoff);
+	}
+
 /*
  *	Resolve the atom-diatom eigenvalues for each j-case and sort results as scatt. channels:
  */
@@ -149,6 +171,7 @@ int main(int argc, char *argv[])
 	printf("# -----------------------------------------------------------------------------------------------------\n");
 
 	size_t *ch_counter = allocate(J_max + 1, sizeof(size_t), true);
+	size_t *drop_counter = allocate(J_max + 1, sizeof(size_t), true);
 
 	fgh_basis basis =
 	{
@@ -199,10 +222,15 @@ int main(int argc, char *argv[])
 		{
 			basis.eigenval = eigenval[basis.v];
 
+			const bool keep = (basis.eigenval <= cutoff);
+
 			for (basis.n = 0; basis.n < max_state; ++basis.n)
 			{
-				basis.eigenvec
-					= fgh_multi_channel_eigenvec(fgh, R_step, max_state, basis.v, basis.n);
+				if (keep)
+				{
+					basis.eigenvec
+						= fgh_multi_channel_eigenvec(fgh, R_step, max_state, basis.v, basis.n);
+				}
 
 				for (size_t J = J_min; J <= J_max; J += J_step)
 				{
@@ -210,7 +238,14 @@ int main(int argc, char *argv[])
 					{
 						if (parity(basis.j + basis.l) != J_parity && J_parity != 0) continue;
 
-						print_level(&basis, ch_counter[J], J);
+						if (!keep)
+						{
+							print_level(dropped, &basis, drop_counter[J], J);
+							drop_counter[J] += 1;
+							continue;
+						}
+
+						print_level(stdout, &basis, ch_counter[J], J);
 
 						fgh_basis_save(&basis, dir, arrang, ch_counter[J], J);
 
@@ -219,6 +254,7 @@ int main(int argc, char *argv[])
 				}
 
 				free(basis.eigenvec);
+				basis.eigenvec = NULL;
 			}
 		}
 
@@ -226,8 +262,26 @@ int main(int argc, char *argv[])
 		free(eigenval);
 	}
 
+/*
+ *	NOTE: basis files of a previous run beyond the contracted set are removed, so
+ *	that the coupling and propagation stages only count the channels kept.
+ */
+
+	if (energy_cutoff)
+	{
+		for (size_t J = J_min; J <= J_max; J += J_step)
+		{
+			fgh_basis_trim(dir, arrang, ch_counter[J], J);
+
+			printf("# J = %zu: %zu channels kept, %zu dropped\n", J, ch_counter[J], drop_counter[J]);
+		}
+
+		file_close(&dropped);
+	}
+
 	free(dir);
 	free(ch_counter);
+	free(drop_counter);
 
 	matrix_end_gpu();
 
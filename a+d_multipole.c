@@ -1,4 +1,5 @@
 #include "modules/pes.h"
+#include "modules/fgh.h"
 #include "modules/file.h"
 #include "modules/mpi_lib.h"
 #include "modules/globals.h"
@@ -26,7 +27,7 @@ double driver(const char arrang, const size_t max_task,
 
 	const double start_time = wall_time();
 
-	#pragma omp parallel for default(none) shared(job, m) schedule(static) if(use_omp)
+	#pragma omp parallel for default(none) shared(job, m) firstprivate(arrang, max_task) schedule(static) if(use_omp)
 	for (size_t task = 0; task < max_task; ++task)
 	{
 		const size_t n = job[task].index;
@@ -66,13 +67,48 @@ int main(int argc, char *argv[])
  *	Vibrational grid:
  */
 
-	const size_t rovib_grid_size = read_int_keyword(stdin, "rovib_grid_size", 1, 1000000, 1000);
+	size_t rovib_grid_size = read_int_keyword(stdin, "rovib_grid_size", 1, 1000000, 1000);
 
-	const double r_min = read_dbl_keyword(stdin, "r_min", 0.0, INF, 0.5);
+	double r_min = read_dbl_keyword(stdin, "r_min", 0.0, INF, 0.5);
 
-	const double r_max = read_dbl_keyword(stdin, "r_max", r_min, INF, r_min + 30.0);
+	double r_max = read_dbl_keyword(stdin, "r_max", r_min, INF, r_min + 30.0);
 
-	const double r_step = (r_max - r_min)/as_double(rovib_grid_size);
+	double r_step = (r_max - r_min)/as_double(rovib_grid_size);
+
+/*
+ *	Non-uniform vibrational grids (mapped or potential-optimized): the points are
+ *	taken from the first basis function of the lowest J in basis_dir.
+ */
+
+	const size_t rovib_grid_type = read_int_keyword(stdin, "rovib_grid_type", 0, 2, 0);
+
+	double *r_grid = NULL;
+
+	if (rovib_grid_type != 0)
+	{
+		const size_t J_min = read_int_keyword(stdin, "J_min", 0, 10000, 0);
+
+		char *basis_dir = read_str_keyword(stdin, "basis_dir", ".");
+
+		fgh_basis b;
+		fgh_basis_load(&b, basis_dir, arrang, 0, J_min);
+
+		if (b.r == NULL)
+		{
+			PRINT_ERROR("basis in %s is not on a non-uniform grid\n", basis_dir)
+			exit(EXIT_FAILURE);
+		}
+
+		rovib_grid_size = b.grid_size;
+		r_min = b.r_min;
+		r_max = b.r_max;
+		r_step = 0.0;
+		r_grid = b.r;
+
+		free(b.eigenvec);
+		free(b.weight);
+		free(basis_dir);
+	}
 
 /*
  *	Scattering grid:
@@ -119,7 +155,7 @@ int main(int argc, char *argv[])
 
 			ASSERT(list != NULL)
 
-			list[counter - 1].r = r_min + as_double(n)*r_step;
+			list[counter - 1].r = (r_grid != NULL? r_grid[n] : r_min + as_double(n)*r_step);
 			list[counter - 1].lambda = lambda;
 			list[counter - 1].index = n;
 		}
@@ -183,6 +219,7 @@ int main(int argc, char *argv[])
 
 	pes_multipole_free(&m);
 	free(list);
+	free(r_grid);
 	free(dir);
 
 	mpi_end();
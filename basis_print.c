@@ -53,12 +53,13 @@ int main(int argc, char *argv[])
 			fprintf(output, "# j = %zu\n", b.j);
 			fprintf(output, "# l = %zu\n", b.l);
 			fprintf(output, "# Component  = %zu\n", b.n);
+			fprintf(output, "# Helicity   = %zu\n", b.omega);
 			fprintf(output, "# Eigenvalue = % -8e\n", b.eigenval);
 			fprintf(output, "# File created at %s\n", time_stamp());
 
 			for (size_t n = 0; n < b.grid_size; ++n)
 			{
-				const double r = b.r_min + as_double(n)*b.r_step;
+				const double r = (b.r != NULL? b.r[n] : b.r_min + as_double(n)*b.r_step);
 /*
  *				NOTE: "% -8e\t" print numbers left-justified with an invisible
  *				plus sign, if any, 8 digits wide in scientific notation + tab.
@@ -68,6 +69,8 @@ int main(int argc, char *argv[])
 
 			file_close(&output);
 			free(b.eigenvec);
+			free(b.weight);
+			free(b.r);
 		}
 	}
 
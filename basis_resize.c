@@ -69,6 +69,12 @@ int main(int argc, char *argv[])
 
 	const double shift = read_dbl_keyword(stdin, "energy_shift", -INF, INF, 0.0);
 
+/*
+ *	Half-width of the sinc kernel (0 to keep all old points):
+ */
+
+	const size_t width = read_int_keyword(stdin, "resize_window", 0, 10000, 16);
+
 /*
  *	Directory to load basis functions from:
  */
@@ -86,40 +92,71 @@ int main(int argc, char *argv[])
 	{
 		const size_t max_channel = fgh_basis_count(dir, arrang, J);
 
+		if (max_channel == 0) continue;
+
+		fgh_basis *old = allocate(max_channel, sizeof(fgh_basis), false);
+		fgh_basis *new = allocate(max_channel, sizeof(fgh_basis), false);
+
+		double **old_eigenvec = allocate(max_channel, sizeof(double *), false);
+		double **new_eigenvec = allocate(max_channel, sizeof(double *), false);
+
 		for (size_t ch = 0; ch < max_channel; ++ch)
 		{
-			fgh_basis old, new;
-			fgh_basis_load(&old, dir, arrang, ch, J);
-
-			ASSERT(r_min >= old.r_min)
-			ASSERT(r_max <= old.r_max)
+			fgh_basis_load(&old[ch], dir, arrang, ch, J);
+
+			/* NOTE: the sinc resampling is only defined on uniform grids. */
+			ASSERT(old[ch].r_step > 0.0)
+
+			ASSERT(r_min >= old[ch].r_min)
+			ASSERT(r_max <= old[ch].r_max)
+
+			ASSERT(old[ch].grid_size == old[0].grid_size)
+			ASSERT(old[ch].r_min == old[0].r_min)
+			ASSERT(old[ch].r_max == old[0].r_max)
+
+			new[ch].v = old[ch].v;
+			new[ch].j = old[ch].j;
+			new[ch].l = old[ch].l;
+			new[ch].n = old[ch].n;
+			new[ch].omega = old[ch].omega;
+			new[ch].r_min = r_min;
+			new[ch].r_max = r_max;
+			new[ch].r_step = r_step;
+			new[ch].grid_size = n_max;
+			new[ch].eigenval = old[ch].eigenval + shift;
+			new[ch].eigenvec = allocate(n_max, sizeof(double), false);
+			new[ch].r = NULL;
+			new[ch].weight = NULL;
+
+			old_eigenvec[ch] = old[ch].eigenvec;
+			new_eigenvec[ch] = new[ch].eigenvec;
+		}
 
-			new.v = old.v;
-			new.j = old.j;
-			new.l = old.l;
-			new.n = old.n;
-			new.r_min = r_min;
-			new.r_max = r_max;
-			new.r_step = r_step;
-			new.grid_size = n_max;
-			new.eigenval = old.eigenval + shift;
-			new.eigenvec = allocate(n_max, sizeof(double), false);
+/*
+ *		NOTE: all channels share the same grid, thus the kernel is computed only once
+ *		and every channel is resampled by the same banded product.
+ */
 
-			for (size_t n = 0; n < n_max; ++n)
-			{
-				const double r = r_min + as_double(n)*r_step;
+		fgh_kernel *k = fgh_kernel_alloc(old[0].grid_size, old[0].r_min,
+		                                 old[0].r_max, n_max, r_min, r_max, width);
 
-				new.eigenvec[n]
-					= fgh_interpolation(old.grid_size, old.eigenvec, old.r_min, old.r_max, r);
-			}
+		fgh_kernel_apply(k, max_channel, old_eigenvec, new_eigenvec);
 
-			print_level(&new, ch, J);
+		for (size_t ch = 0; ch < max_channel; ++ch)
+		{
+			print_level(&new[ch], ch, J);
 
-			fgh_basis_save(&new, ".", arrang, ch, J);
+			fgh_basis_save(&new[ch], ".", arrang, ch, J);
 
-			free(old.eigenvec);
-			free(new.eigenvec);
+			free(old[ch].eigenvec);
+			free(new[ch].eigenvec);
 		}
+
+		fgh_kernel_free(k);
+		free(old_eigenvec);
+		free(new_eigenvec);
+		free(old);
+		free(new);
 	}
 
 	free(dir);
@@ -1,6 +1,7 @@
 #include "modules/pes.h"
 #include "modules/fgh.h"
 #include "modules/file.h"
+#include "modules/johnson.h"
 #include "modules/matrix.h"
 #include "modules/globals.h"
 
@@ -25,12 +26,503 @@ inline static int parity(const size_t l)
 
 ******************************************************************************/
 
-void print_level(const fgh_basis *b, const size_t ch, const size_t J)
+void print_level(FILE *output, const fgh_basis *b, const size_t ch, const size_t J)
 {
-	printf(FORMAT, J, ch, b->v, b->j, b->l, parity(b->j + b->l),
+	fprintf(output, FORMAT, J, ch, b->v, b->j, b->l, parity(b->j + b->l),
 	       b->eigenval, b->eigenval*219474.63137054, b->eigenval*27.211385);
 }
 
+/******************************************************************************
+
+ Function rovib_matrix(): return a copy of the rotationless Hamiltonian, base,
+ plus the centrifugal term j(j + 1)/2mr^2 at each grid point r[n].
+
+******************************************************************************/
+
+matrix *rovib_matrix(const matrix *base,
+                     const double r[], const double mass, const size_t j)
+{
+	matrix *fgh = matrix_alloc_as(base, false);
+
+	matrix_copy(fgh, base, 1.0, 0.0);
+
+	for (size_t n = 0; n < matrix_rows(base); ++n)
+		matrix_incr(fgh, n, n, as_double(j*(j + 1))/(2.0*mass*r[n]*r[n]));
+
+	return fgh;
+}
+
+/******************************************************************************
+
+ Function weighted_eigenvec(): converts the eigenvector c of a non-uniform grid
+ Hamiltonian into the wavefunction at the grid points, c[n]/sqrt(weight[n]),
+ normalized as sum_n weight[n]*wavef[n]^2 = 1.
+
+******************************************************************************/
+
+void weighted_eigenvec(const size_t grid_size, const double weight[], double c[])
+{
+	double norm = 0.0;
+	for (size_t n = 0; n < grid_size; ++n)
+		norm += c[n]*c[n];
+
+	norm = sqrt(norm);
+
+	for (size_t n = 0; n < grid_size; ++n)
+		c[n] = c[n]/(norm*sqrt(weight[n]));
+}
+
+/******************************************************************************
+
+ Function sweep(): solves the FGH problem for all j = j_min, j_min + j_step, ...
+ at once, where the rotationless Hamiltonian, base, at the grid points r[n] is
+ computed only once. For each j, only the centrifugal term j(j + 1)/2mr^2 is
+ added to the diagonal and the lowest max_state eigenpairs are then solved by
+ an iterative eigensolver, using the eigenvectors of the previous j as guess.
+ The j values are split in contiguous blocks, one per thread, and the first j
+ of each block is solved by a dense diagonalization, whose eigenvectors then
+ precondition the iterative solver for the rest of the block.
+
+ NOTE: on exit, the columns of eigenvec[jx] are the eigenvectors of the jx-th
+ j value (not normalized) and eigenval[jx] the respective eigenvalues.
+
+******************************************************************************/
+
+void sweep(const matrix *base,
+           const double r[],
+           const double mass,
+           const size_t j_min,
+           const size_t j_step,
+           const size_t j_count,
+           const size_t max_state,
+           const double tol,
+           double *eigenval[],
+           matrix *eigenvec[])
+{
+	const size_t n_max = matrix_rows(base);
+
+	const size_t max_block = min((size_t) max_threads(), j_count);
+
+	#pragma omp parallel for default(none) shared(base, r, eigenval, eigenvec) firstprivate(mass, n_max, j_min, j_step, j_count, max_state, tol, max_block) schedule(static, 1)
+	for (size_t block = 0; block < max_block; ++block)
+	{
+		const size_t jx_min = block*j_count/max_block;
+		const size_t jx_max = (block + 1)*j_count/max_block;
+
+		matrix *ref = NULL;
+		double *ref_eigenval = NULL;
+
+		for (size_t jx = jx_min; jx < jx_max; ++jx)
+		{
+			matrix *fgh = rovib_matrix(base, r, mass, j_min + jx*j_step);
+
+			eigenvec[jx] = matrix_alloc(n_max, max_state, false);
+			eigenval[jx] = allocate(max_state, sizeof(double), false);
+
+			if (jx == jx_min)
+			{
+/*
+ *				NOTE: the full spectrum of the first j is kept to precondition the
+ *				iterative solver for the remaining ones of the block.
+ */
+				ref_eigenval = matrix_symm_eigen(fgh, 'v');
+
+				ref = matrix_alloc_as(fgh, false);
+
+				for (size_t n = 0; n < n_max; ++n)
+				{
+					for (size_t v = 0; v < n_max; ++v)
+					{
+						if (matrix_using_magma())
+							matrix_set(ref, n, v, matrix_get(fgh, v, n));
+						else
+							matrix_set(ref, n, v, matrix_get(fgh, n, v));
+					}
+				}
+
+				for (size_t v = 0; v < max_state; ++v)
+				{
+					eigenval[jx][v] = ref_eigenval[v];
+
+					for (size_t n = 0; n < n_max; ++n)
+						matrix_set(eigenvec[jx], n, v, matrix_get(ref, n, v));
+				}
+			}
+			else
+			{
+				matrix_copy(eigenvec[jx], eigenvec[jx - 1], 1.0, 0.0);
+
+				double *result = matrix_symm_partial_eigen(fgh, eigenvec[jx],
+				                                           ref, ref_eigenval, tol, 100);
+
+				for (size_t v = 0; v < max_state; ++v)
+					eigenval[jx][v] = result[v];
+
+				free(result);
+			}
+
+			matrix_free(fgh);
+		}
+
+		if (ref != NULL) matrix_free(ref);
+		free(ref_eigenval);
+	}
+}
+
+/******************************************************************************
+
+ Function numerov_search(): solves the v = v_min, v_min + v_step, ... levels of
+ all j = j_min, j_min + j_step, ... on the uniform grid r[n] by the eigenvalue
+ search of johnson_jcp77_eigen(), instead of a dense diagonalization. Each
+ (v, j) pair is an independent task and tasks are shared among threads, each
+ one reusing a single workspace for all its trial energies. Only the requested
+ levels are solved, which is much cheaper than the full FGH spectrum if just
+ a handful of them are needed.
+
+ NOTE: on exit, the v-th column of eigenvec[jx] is the unnormalized Numerov
+ wavefunction of the v-th level of the jx-th j value and eigenval[jx][v] its
+ eigenvalue. Columns of levels not requested are left as zero.
+
+******************************************************************************/
+
+void numerov_search(double (*pec)(const size_t, const double),
+                    const double r[],
+                    const double r_step,
+                    const size_t n_max,
+                    const double mass,
+                    const size_t j_min,
+                    const size_t j_step,
+                    const size_t j_count,
+                    const size_t v_min,
+                    const size_t v_step,
+                    const size_t v_count,
+                    const double tol,
+                    double *eigenval[],
+                    matrix *eigenvec[])
+{
+	const size_t max_state = v_min + (v_count - 1)*v_step + 1;
+
+	double **pot_energy = allocate(j_count, sizeof(double *), false);
+
+	for (size_t jx = 0; jx < j_count; ++jx)
+	{
+		pot_energy[jx] = allocate(n_max, sizeof(double), false);
+
+		for (size_t n = 0; n < n_max; ++n)
+			pot_energy[jx][n] = pec(j_min + jx*j_step, r[n]);
+
+		eigenvec[jx] = matrix_alloc(n_max, max_state, true);
+		eigenval[jx] = allocate(max_state, sizeof(double), true);
+	}
+
+	const size_t max_task = j_count*v_count;
+
+	#pragma omp parallel default(none) shared(pot_energy, eigenval, eigenvec) firstprivate(r_step, n_max, mass, v_min, v_step, v_count, tol, max_task)
+	{
+		johnson_jcp77_workspace *work = johnson_jcp77_workspace_alloc(n_max);
+
+		double *wavef = allocate(n_max, sizeof(double), false);
+
+		#pragma omp for schedule(dynamic, 1)
+		for (size_t task = 0; task < max_task; ++task)
+		{
+			const size_t jx = task/v_count, v = v_min + (task%v_count)*v_step;
+
+/*
+ *			NOTE: the search starts from [min. V(r), V(r_max)], whose upper bound
+ *			is raised by johnson_jcp77_eigen() if the level lies above it.
+ */
+
+			double E_min = pot_energy[jx][0];
+
+			for (size_t n = 1; n < n_max; ++n)
+				if (pot_energy[jx][n] < E_min) E_min = pot_energy[jx][n];
+
+			double E_max = pot_energy[jx][n_max - 1];
+
+			if (E_max <= E_min) E_max = E_min + 1.0;
+
+			eigenval[jx][v] = johnson_jcp77_eigen(n_max, r_step, pot_energy[jx],
+			                                      mass, v, E_min, E_max, tol, wavef, work);
+
+			for (size_t n = 0; n < n_max; ++n)
+				matrix_set(eigenvec[jx], n, v, wavef[n]);
+		}
+
+		johnson_jcp77_workspace_free(work);
+		free(wavef);
+	}
+
+	for (size_t jx = 0; jx < j_count; ++jx)
+		free(pot_energy[jx]);
+
+	free(pot_energy);
+}
+
+/******************************************************************************
+
+ Type trial: a trial uniform grid of the autotune mode, with grid_size points in
+ [r_min, r_max), and the respective lowest eigenpairs for a given j.
+
+******************************************************************************/
+
+struct trial
+{
+	size_t grid_size;
+	double r_min, r_max, *eigenval;
+	matrix *eigenvec;
+};
+
+/******************************************************************************
+
+ Function trial_solve(): solves the lowest max_state eigenpairs of pec(j, r) on
+ the grid of t. If old is not null, its eigenvectors are resampled onto the new
+ grid as starting vectors of the iterative eigensolver, otherwise a dense
+ diagonalization is used. The wall time in seconds is returned.
+
+******************************************************************************/
+
+double trial_solve(double (*pec)(const size_t, const double),
+                   const double mass,
+                   const size_t j,
+                   const size_t max_state,
+                   const double tol,
+                   const struct trial *old,
+                   struct trial *t)
+{
+	const double start_time = wall_time();
+
+	const double r_step = (t->r_max - t->r_min)/as_double(t->grid_size);
+
+	double *pot_energy = allocate(t->grid_size, sizeof(double), false);
+
+	for (size_t n = 0; n < t->grid_size; ++n)
+		pot_energy[n] = pec(j, t->r_min + as_double(n)*r_step);
+
+	matrix *fgh = fgh_dense_single_channel(t->grid_size, r_step, pot_energy, mass);
+
+	free(pot_energy);
+
+	t->eigenvec = matrix_alloc(t->grid_size, max_state, false);
+	t->eigenval = allocate(max_state, sizeof(double), false);
+
+	if (old == NULL)
+	{
+		double *eigenval = matrix_symm_eigen(fgh, 'v');
+
+		for (size_t v = 0; v < max_state; ++v)
+		{
+			t->eigenval[v] = eigenval[v];
+
+			for (size_t n = 0; n < t->grid_size; ++n)
+			{
+				if (matrix_using_magma())
+					matrix_set(t->eigenvec, n, v, matrix_get(fgh, v, n));
+				else
+					matrix_set(t->eigenvec, n, v, matrix_get(fgh, n, v));
+			}
+		}
+
+		free(eigenval);
+	}
+	else
+	{
+		fgh_kernel *k = fgh_kernel_alloc(old->grid_size, old->r_min, old->r_max,
+		                                 t->grid_size, t->r_min, t->r_max, 16);
+
+		double **old_eigenvec = allocate(max_state, sizeof(double *), false);
+		double **new_eigenvec = allocate(max_state, sizeof(double *), false);
+
+		for (size_t v = 0; v < max_state; ++v)
+		{
+			old_eigenvec[v] = matrix_get_raw_col(old->eigenvec, v);
+			new_eigenvec[v] = allocate(t->grid_size, sizeof(double), false);
+		}
+
+		fgh_kernel_apply(k, max_state, old_eigenvec, new_eigenvec);
+
+		for (size_t v = 0; v < max_state; ++v)
+		{
+			for (size_t n = 0; n < t->grid_size; ++n)
+				matrix_set(t->eigenvec, n, v, new_eigenvec[v][n]);
+
+			free(old_eigenvec[v]);
+			free(new_eigenvec[v]);
+		}
+
+		free(old_eigenvec);
+		free(new_eigenvec);
+		fgh_kernel_free(k);
+
+		double *eigenval
+			= matrix_symm_partial_eigen(fgh, t->eigenvec, NULL, NULL, tol, 30);
+
+		for (size_t v = 0; v < max_state; ++v)
+			t->eigenval[v] = eigenval[v];
+
+		free(eigenval);
+	}
+
+	matrix_free(fgh);
+
+	return wall_time() - start_time;
+}
+
+/******************************************************************************
+
+ Function autotune(): searches for the smallest uniform grid that reproduces the
+ eigenvalues of all v = v_min, v_min + v_step, ..., v_max states of j_min and
+ j_max within tol, relative to the grid given in the input. First, r_max and
+ then r_min are trimmed by 5% of the range at each trial, with the step kept
+ fixed; then the number of points is reduced by 10% at each trial, with the
+ range kept fixed. Each trial is warm-started by the eigenvectors of the last
+ accepted grid. The minimal grid found and the downstream savings, which are
+ proportional to the grid size for the multipoles, coupling integrals and basis
+ files, are printed.
+
+******************************************************************************/
+
+void autotune(double (*pec)(const size_t, const double),
+              const double mass,
+              const size_t j_min,
+              const size_t j_max,
+              const size_t v_min,
+              const size_t v_max,
+              const size_t v_step,
+              const size_t grid_size,
+              const double r_min,
+              const double r_max,
+              const double tol)
+{
+	const size_t max_j = (j_max > j_min? 2 : 1), max_state = v_max + 1;
+
+	const size_t j[2] = {j_min, j_max};
+
+	const double r_step = (r_max - r_min)/as_double(grid_size);
+
+	struct trial best[2], ref[2];
+
+	double ref_time = 0.0, best_time = 0.0;
+
+	for (size_t i = 0; i < max_j; ++i)
+	{
+		ref[i].grid_size = grid_size;
+		ref[i].r_min = r_min;
+		ref[i].r_max = r_max;
+
+		ref_time += trial_solve(pec, mass, j[i], max_state, tol, NULL, &ref[i]);
+
+		best[i] = ref[i];
+	}
+
+	printf("# Autotune: tol. = %e a.u., j = %zu and %zu, v = [%zu, %zu]\n", tol, j_min, j_max, v_min, v_max);
+	printf("#   grid size     r_min (a.u.)     r_max (a.u.)     max. error (a.u.)    accepted\n");
+	printf("# ---------------------------------------------------------------------------\n");
+
+	const double trim = 0.05*(r_max - r_min);
+
+	for (size_t stage = 0; stage < 3; ++stage)
+	{
+		while (true)
+		{
+			struct trial new = {.grid_size = best[0].grid_size,
+			                    .r_min = best[0].r_min, .r_max = best[0].r_max};
+
+			switch (stage)
+			{
+				case 0:
+					new.r_max = new.r_max - trim;
+					new.grid_size = (size_t) round((new.r_max - new.r_min)/r_step);
+				break;
+
+				case 1:
+					new.r_min = new.r_min + trim;
+					new.grid_size = (size_t) round((new.r_max - new.r_min)/r_step);
+				break;
+
+				default:
+					new.grid_size = 9*new.grid_size/10;
+				break;
+			}
+
+			if (new.grid_size <= max_state || new.r_max <= new.r_min) break;
+
+			struct trial t[2];
+
+			double error = 0.0, time = 0.0;
+
+			for (size_t i = 0; i < max_j; ++i)
+			{
+				t[i] = new;
+
+				time += trial_solve(pec, mass, j[i], max_state, tol, &best[i], &t[i]);
+
+				for (size_t v = v_min; v <= v_max; v += v_step)
+				{
+					const double diff = fabs(t[i].eigenval[v] - ref[i].eigenval[v]);
+					if (diff > error) error = diff;
+				}
+			}
+
+			const bool accepted = (error < tol);
+
+			printf("  %10zu     %12.6f     %12.6f     %16.8e      %s\n",
+			       new.grid_size, new.r_min, new.r_max, error, (accepted? "yes" : "no"));
+
+			for (size_t i = 0; i < max_j; ++i)
+			{
+				struct trial *drop = (accepted? &best[i] : &t[i]);
+
+				if (accepted) best_time = time;
+
+				if (drop->eigenvec != ref[i].eigenvec)
+				{
+					matrix_free(drop->eigenvec);
+					free(drop->eigenval);
+				}
+
+				if (accepted) best[i] = t[i];
+			}
+
+			if (!accepted) break;
+		}
+	}
+
+	if (best_time == 0.0) best_time = ref_time;
+
+	const double ratio = as_double(grid_size)/as_double(best[0].grid_size);
+
+	printf("#\n");
+	printf("# Minimal grid: rovib_grid_size = %zu, r_min = %f, r_max = %f\n",
+	       best[0].grid_size, best[0].r_min, best[0].r_max);
+
+	printf("# Input grid:   rovib_grid_size = %zu, r_min = %f, r_max = %f\n",
+	       grid_size, r_min, r_max);
+
+	printf("# Basis file per channel: %.2f kB -> %.2f kB\n",
+	       as_double(grid_size*sizeof(double))/1024.0, as_double(best[0].grid_size*sizeof(double))/1024.0);
+
+	printf("# Multipoles and coupling integrals: %.2fx less time and memory\n", ratio);
+
+	printf("# Dense FGH diagonalization: %.2fx less time (~n^3), %.2fx less memory (~n^2)\n",
+	       ratio*ratio*ratio, ratio*ratio);
+
+	printf("# Measured wall time per j: %f s (input grid) -> %f s (warm-started minimal grid)\n",
+	       ref_time/as_double(max_j), best_time/as_double(max_j));
+
+	for (size_t i = 0; i < max_j; ++i)
+	{
+		if (best[i].eigenvec != ref[i].eigenvec)
+		{
+			matrix_free(best[i].eigenvec);
+			free(best[i].eigenval);
+		}
+
+		matrix_free(ref[i].eigenvec);
+		free(ref[i].eigenval);
+	}
+}
+
 /******************************************************************************
 ******************************************************************************/
 
@@ -54,6 +546,15 @@ int main(int argc, char *argv[])
 
 	const int J_parity = read_int_keyword(stdin, "J_parity", -1, 1, 0);
 
+/*
+ *	Coupled-states (CS) approximation: the orbital term is replaced by l = J and
+ *	channels are labelled by their body-fixed helicity, 0 <= omega <= min(j, J),
+ *	instead of l. The parity is not used and each omega > 0 stands for the pair
+ *	of degenerate blocks +/-omega:
+ */
+
+	const bool coupled_states = (bool) read_int_keyword(stdin, "coupled_states", 0, 1, 0);
+
 /*
  *	Vibrational quantum numbers, v:
  */
@@ -86,6 +587,36 @@ int main(int argc, char *argv[])
 
 	const double r_step = (r_max - r_min)/as_double(n_max);
 
+/*
+ *	Grid type: uniform (0), mapped Fourier grid (1) or potential-optimized DVR (2):
+ */
+
+	const size_t grid_type = read_int_keyword(stdin, "rovib_grid_type", 0, 2, 0);
+
+/*
+ *	Sweep mode: one kinetic matrix for all j and warm-started eigensolver:
+ */
+
+	const bool j_sweep = (bool) read_int_keyword(stdin, "j_sweep", 0, 1, 0);
+
+	const double sweep_tol = read_dbl_keyword(stdin, "j_sweep_tol", 0.0, INF, 1.0E-8);
+
+/*
+ *	Numerov search mode: each (v, j) level by a node-count bracketed secant search:
+ */
+
+	const bool use_numerov = (bool) read_int_keyword(stdin, "numerov_search", 0, 1, 0);
+
+	const double numerov_tol = read_dbl_keyword(stdin, "numerov_search_tol", 0.0, INF, 1.0E-10);
+
+/*
+ *	Autotune mode: search for the minimal grid (in the above range) and exit:
+ */
+
+	const bool autotune_grid = (bool) read_int_keyword(stdin, "autotune", 0, 1, 0);
+
+	const double autotune_tol = read_dbl_keyword(stdin, "autotune_tol", 0.0, INF, 1.0E-6);
+
 /*
  *	Arrangement (a = 1, b = 2, c = 3), atomic masses and PES:
  */
@@ -124,21 +655,107 @@ int main(int argc, char *argv[])
 
 	ASSERT(mass != 0.0)
 
+	if (autotune_grid)
+	{
+		ASSERT(grid_type == 0)
+
+		autotune(pec, mass, j_min, j_max, v_min, v_max,
+		         v_step, n_max, r_min, r_max, autotune_tol);
+
+		matrix_end_gpu();
+		return EXIT_SUCCESS;
+	}
+
+/*
+ *	Grid points and, for non-uniform grids, the rotationless Hamiltonian and the
+ *	quadrature weights. For uniform grids in sweep mode, the former is the FGH
+ *	matrix of pec(0, r):
+ */
+
+	double *r = allocate(n_max, sizeof(double), false);
+	double *weight = NULL;
+	matrix *base = NULL;
+
+	if (grid_type == 0)
+	{
+		for (size_t n = 0; n < n_max; ++n)
+			r[n] = r_min + as_double(n)*r_step;
+
+		if (j_sweep)
+		{
+			double *pot_energy = allocate(n_max, sizeof(double), false);
+
+			for (size_t n = 0; n < n_max; ++n)
+				pot_energy[n] = pec(0, r[n]);
+
+			base = fgh_dense_single_channel(n_max, r_step, pot_energy, mass);
+
+			free(pot_energy);
+		}
+	}
+	else if (grid_type == 1)
+	{
+		const double energy = read_dbl_keyword(stdin, "mapped_energy", -INF, INF, pec(0, r_max));
+
+		weight = allocate(n_max, sizeof(double), false);
+
+		fgh_mapped_grid(n_max, r_min, r_max, mass, energy, pec, r, weight);
+
+		base = fgh_mapped_kinetic(n_max, weight, mass);
+
+		for (size_t n = 0; n < n_max; ++n)
+			matrix_incr(base, n, n, pec(0, r[n]));
+	}
+	else
+	{
+		const size_t prim_size
+			= read_int_keyword(stdin, "podvr_prim_grid_size", n_max + 1, 1000000, 4*n_max);
+
+		weight = allocate(n_max, sizeof(double), false);
+
+		base = fgh_podvr(n_max, prim_size, r_min, r_max, mass, pec, r, weight);
+	}
+
 /*
  *	Directory to store all basis functions:
  */
 
 	char *dir = read_str_keyword(stdin, "basis_dir", ".");
 
+/*
+ *	Energy cutoff: only channels whose asymptotic level is below E_max + E_margin
+ *	are kept, the others are listed in the basis dir. as dropped channels:
+ */
+
+	const bool energy_cutoff = (bool) read_int_keyword(stdin, "energy_cutoff", 0, 1, 0);
+
+	const double E_max = read_dbl_keyword(stdin, "E_max", -INF, INF, INF);
+
+	const double E_margin = read_dbl_keyword(stdin, "E_margin", 0.0, INF, 0.0);
+
+	const double cutoff = (energy_cutoff? E_max + E_margin : INF);
+
+	FILE *dropped = NULL;
+
+	if (energy_cutoff)
+	{
+		dropped = fgh_dropped_file(dir, arrang, "w");
+
+		fprintf(dropped, "# Channels above the energy cutoff = % -8e a.u.\n", cutoff);
+	}
+
 /*
  *	Resolve the diatomic eigenvalue for each j-case and sort results as scatt. channels:
  */
 
+	if (coupled_states) printf("# Coupled states: l = J and one channel per helicity omega\n");
+
 	printf("# Reduced mass = %f a.u., basis dir. = %s, PES name = %s\n", mass, dir, pes_name());
 	printf("#     J      ch.      v       j       l       p        E (a.u.)       E (cm-1)        E (eV)   \n");
 	printf("# ---------------------------------------------------------------------------------------------\n");
 
 	size_t *ch_counter = allocate(J_max + 1, sizeof(size_t), true);
+	size_t *drop_counter = allocate(J_max + 1, sizeof(size_t), true);
 
 	fgh_basis basis =
 	{
@@ -146,39 +763,123 @@ int main(int argc, char *argv[])
 		.j = 0,
 		.l = 0,
 		.n = 0,
+		.omega = 0,
 		.r_min = r_min,
 		.r_max = r_max,
-		.r_step = r_step,
+		.r_step = (weight != NULL? 0.0 : r_step),
 		.grid_size = n_max,
 		.eigenval = 0.0,
-		.eigenvec = NULL
+		.eigenvec = NULL,
+		.r = (weight != NULL? r : NULL),
+		.weight = weight
 	};
 
+	const size_t j_count = (j_max - j_min)/j_step + 1;
+
+	double **sweep_eigenval = NULL;
+	matrix **sweep_eigenvec = NULL;
+
+	if (j_sweep || use_numerov)
+	{
+		sweep_eigenval = allocate(j_count, sizeof(double *), true);
+		sweep_eigenvec = allocate(j_count, sizeof(matrix *), true);
+	}
+
+	if (j_sweep)
+	{
+		sweep(base, r, mass, j_min, j_step, j_count,
+		      v_max + 1, sweep_tol, sweep_eigenval, sweep_eigenvec);
+	}
+	else if (use_numerov)
+	{
+		ASSERT(grid_type == 0)
+
+		numerov_search(pec, r, r_step, n_max, mass, j_min, j_step, j_count,
+		               v_min, v_step, (v_max - v_min)/v_step + 1, numerov_tol,
+		               sweep_eigenval, sweep_eigenvec);
+	}
+
 	for (basis.j = j_min; basis.j <= j_max; basis.j += j_step)
 	{
-		double *pot_energy = allocate(n_max, sizeof(double), false);
+		const size_t jx = (basis.j - j_min)/j_step;
 
-		for (size_t n = 0; n < n_max; ++n)
-			pot_energy[n] = pec(basis.j, r_min + as_double(n)*r_step);
+		matrix *fgh = NULL;
+		double *eigenval = NULL;
+
+		if (j_sweep || use_numerov)
+		{
+			fgh = sweep_eigenvec[jx];
+			eigenval = sweep_eigenval[jx];
+		}
+		else if (weight != NULL)
+		{
+			fgh = rovib_matrix(base, r, mass, basis.j);
 
-		matrix *fgh = fgh_dense_single_channel(n_max, r_step, pot_energy, mass);
+			eigenval = matrix_symm_eigen(fgh, 'v');
+		}
+		else
+		{
+			double *pot_energy = allocate(n_max, sizeof(double), false);
 
-		free(pot_energy);
+			for (size_t n = 0; n < n_max; ++n)
+				pot_energy[n] = pec(basis.j, r[n]);
 
-		double *eigenval = matrix_symm_eigen(fgh, 'v');
+			fgh = fgh_dense_single_channel(n_max, r_step, pot_energy, mass);
+
+			free(pot_energy);
+
+			eigenval = matrix_symm_eigen(fgh, 'v');
+		}
 
 		for (basis.v = v_min; basis.v <= v_max; basis.v += v_step)
 		{
 			basis.eigenval = eigenval[basis.v];
-			basis.eigenvec = fgh_eigenvec(fgh, basis.v, r_step);
+
+			const bool keep = (basis.eigenval <= cutoff);
+
+			if (!keep)
+			{
+				basis.eigenvec = NULL;
+			}
+			else if (weight != NULL)
+			{
+				if (j_sweep || !matrix_using_magma())
+					basis.eigenvec = matrix_get_raw_col(fgh, basis.v);
+				else
+					basis.eigenvec = matrix_get_raw_row(fgh, basis.v);
+
+				weighted_eigenvec(n_max, weight, basis.eigenvec);
+			}
+			else if (j_sweep || use_numerov)
+			{
+				basis.eigenvec = matrix_get_raw_col(fgh, basis.v);
+				fgh_normalize(n_max, basis.eigenvec, r_step);
+			}
+			else
+			{
+				basis.eigenvec = fgh_eigenvec(fgh, basis.v, r_step);
+			}
 
 			for (size_t J = J_min; J <= J_max; J += J_step)
 			{
-				for (basis.l = abs(J - basis.j); basis.l <= (J + basis.j); ++basis.l)
+				const size_t k_min = (coupled_states? 0 : abs(J - basis.j));
+				const size_t k_max = (coupled_states? (J < basis.j? J : basis.j) : J + basis.j);
+
+				for (size_t k = k_min; k <= k_max; ++k)
 				{
-					if (parity(basis.j + basis.l) != J_parity && J_parity != 0) continue;
+					basis.l = (coupled_states? J : k);
+					basis.omega = (coupled_states? k : 0);
+
+					if (!coupled_states && parity(basis.j + basis.l) != J_parity && J_parity != 0) continue;
 
-					print_level(&basis, ch_counter[J], J);
+					if (!keep)
+					{
+						print_level(dropped, &basis, drop_counter[J], J);
+						drop_counter[J] += 1;
+						continue;
+					}
+
+					print_level(stdout, &basis, ch_counter[J], J);
 
 					fgh_basis_save(&basis, dir, arrang, ch_counter[J], J);
 
@@ -193,8 +894,36 @@ int main(int argc, char *argv[])
 		free(eigenval);
 	}
 
+	if (j_sweep || use_numerov)
+	{
+		free(sweep_eigenval);
+		free(sweep_eigenvec);
+	}
+
+	if (base != NULL) matrix_free(base);
+
+	free(r);
+	free(weight);
+/*
+ *	NOTE: basis files of a previous run beyond the contracted set are removed, so
+ *	that the coupling and propagation stages only count the channels kept.
+ */
+
+	if (energy_cutoff)
+	{
+		for (size_t J = J_min; J <= J_max; J += J_step)
+		{
+			fgh_basis_trim(dir, arrang, ch_counter[J], J);
+
+			printf("# J = %zu: %zu channels kept, %zu dropped\n", J, ch_counter[J], drop_counter[J]);
+		}
+
+		file_close(&dropped);
+	}
+
 	free(dir);
 	free(ch_counter);
+	free(drop_counter);
 
 	matrix_end_gpu();
 
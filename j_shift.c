@@ -0,0 +1,455 @@
+#include "modules/pes.h"
+#include "modules/fgh.h"
+#include "modules/file.h"
+#include "modules/matrix.h"
+#include "modules/globals.h"
+
+#if !defined(S_MATRIX_FILE_FORMAT)
+	#define S_MATRIX_FILE_FORMAT "%s/smatrix_%s_arrang=%c_E=%zu_J=%zu.bin"
+#endif
+
+#define FORMAT "  % -8e  % -8e  % -8e  % -8e  % -8e\n"
+
+/******************************************************************************
+
+ Function opacity(): returns the transition probability from the initial state
+ (v_in, j_in) to the final one (v_out, j_out), summed over all orbital angular
+ momenta, P^J = sum |delta - S|^2, at the n-th total energy E. Where, the open-
+ channel S matrix is the one saved by numerov for the given arrangement and J,
+ see save_smatrix(), and is zero if absent (no open channels).
+
+******************************************************************************/
+
+double opacity(const char s_dir[],
+               const char arrang,
+               const size_t J,
+               const size_t n,
+               const double E,
+               const size_t max_channel,
+               const fgh_basis basis[],
+               const size_t v_in,
+               const size_t j_in,
+               const size_t v_out,
+               const size_t j_out)
+{
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, S_MATRIX_FILE_FORMAT, s_dir, "re", arrang, n, J);
+
+	if (!file_exist(filename)) return 0.0;
+
+	matrix *re_part = matrix_load(filename);
+
+	sprintf(filename, S_MATRIX_FILE_FORMAT, s_dir, "im", arrang, n, J);
+
+	matrix *im_part = matrix_load(filename);
+
+/*
+ *	NOTE: open channels are the ones below E, in the same order of the basis.
+ */
+
+	size_t a = 0;
+	double result = 0.0;
+
+	for (size_t i = 0; i < max_channel; ++i)
+	{
+		if (basis[i].eigenval >= E) continue;
+
+		size_t b = 0;
+
+		for (size_t f = 0; f < max_channel; ++f)
+		{
+			if (basis[f].eigenval >= E) continue;
+
+			if (basis[i].v == v_in && basis[i].j == j_in && basis[f].v == v_out && basis[f].j == j_out)
+			{
+				const double re = (a == b? 1.0 : 0.0) - matrix_get(re_part, b, a);
+				const double im = matrix_get(im_part, b, a);
+
+				result += re*re + im*im;
+			}
+
+			++b;
+		}
+
+		ASSERT(b == matrix_rows(re_part))
+		++a;
+	}
+
+	matrix_free(re_part);
+	matrix_free(im_part);
+
+	return result;
+}
+
+/******************************************************************************
+
+ Function energy_interp(): linear interpolation at E of the grid_size values p
+ of a uniform energy grid from E_min, step E_step. Energies below the grid are
+ taken as closed (zero) and above it as the last value.
+
+******************************************************************************/
+
+double energy_interp(const size_t grid_size,
+                     const double p[],
+                     const double E_min,
+                     const double E_step,
+                     const double E)
+{
+	if (E < E_min) return 0.0;
+
+	const double x = (E - E_min)/E_step;
+
+	const size_t n = (size_t) x;
+
+	if (n + 1 >= grid_size) return p[grid_size - 1];
+
+	return p[n] + (x - as_double(n))*(p[n + 1] - p[n]);
+}
+
+/******************************************************************************
+
+ Function j_shift(): returns the opacity of total angular momentum J from the
+ one of J_ref, p, by J-shifting, P^J(E) = P^J_ref(E - B[J(J + 1) - J_ref(J_ref
+ + 1)]), where B is the rotational constant of the bottleneck.
+
+******************************************************************************/
+
+double j_shift(const size_t grid_size,
+               const double p[],
+               const double E_min,
+               const double E_step,
+               const double E,
+               const double B,
+               const size_t J_ref,
+               const size_t J)
+{
+	const double shift = B*(as_double(J*(J + 1)) - as_double(J_ref*(J_ref + 1)));
+
+	return energy_interp(grid_size, p, E_min, E_step, E - shift);
+}
+
+/******************************************************************************
+
+ Function fit_shift(): returns the rotational constant B that best reproduces
+ the opacity b of J_b from the one a of J_a < J_b by J-shifting, in the least-
+ squares sense over all energies. The shift is scanned in steps of E_step/4.
+
+******************************************************************************/
+
+double fit_shift(const size_t grid_size,
+                 const double a[],
+                 const double b[],
+                 const double E_min,
+                 const double E_step,
+                 const size_t J_a,
+                 const size_t J_b)
+{
+	ASSERT(J_b > J_a)
+
+	const double factor = as_double(J_b*(J_b + 1)) - as_double(J_a*(J_a + 1));
+
+	double best_B = 0.0, best_error = INF;
+
+	for (size_t k = 0; k <= 4*grid_size; ++k)
+	{
+		const double B = 0.25*as_double(k)*E_step/factor;
+
+		double error = 0.0;
+
+		for (size_t n = 0; n < grid_size; ++n)
+		{
+			const double E = E_min + as_double(n)*E_step;
+			const double p = j_shift(grid_size, a, E_min, E_step, E, B, J_a, J_b);
+
+			error += (p - b[n])*(p - b[n]);
+		}
+
+		if (error < best_error)
+		{
+			best_B = B;
+			best_error = error;
+		}
+	}
+
+	return best_B;
+}
+
+/******************************************************************************
+
+ Function estimate(): returns the opacity at the n-th energy of a J that is not
+ explicitly propagated, from the max_anchor anchors J_anchor[] (ascending) and
+ their opacities p[]. If mode = 0, it is linearly interpolated in J between the
+ two anchors around J, at fixed energy, otherwise (or above the last anchor) J-
+ shifted from the anchor below J. Anchors in skip, if any, are not used.
+
+******************************************************************************/
+
+double estimate(const int mode,
+                const size_t max_anchor,
+                const size_t J_anchor[],
+                double *p[],
+                const size_t grid_size,
+                const double E_min,
+                const double E_step,
+                const size_t n,
+                const double B,
+                const size_t J,
+                const size_t skip)
+{
+	size_t below = max_anchor, above = max_anchor;
+
+	for (size_t a = 0; a < max_anchor; ++a)
+	{
+		if (a == skip) continue;
+
+		if (J_anchor[a] <= J) below = a;
+		if (J_anchor[a] > J && above == max_anchor) above = a;
+	}
+
+	ASSERT(below < max_anchor)
+
+	if (mode == 0 && above < max_anchor)
+	{
+		const double t = as_double(J - J_anchor[below])/as_double(J_anchor[above] - J_anchor[below]);
+
+		return (1.0 - t)*p[below][n] + t*p[above][n];
+	}
+
+	const double E = E_min + as_double(n)*E_step;
+
+	return j_shift(grid_size, p[below], E_min, E_step, E, B, J_anchor[below], J);
+}
+
+/******************************************************************************
+******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+	ASSERT(argc > 1)
+
+	file_init_stdin(argv[1]);
+
+/*
+ *	Arrangement (a = 1, b = 2, c = 3) and atomic masses:
+ */
+
+	const char arrang = 96 + read_int_keyword(stdin, "arrang", 1, 3, 1);
+
+	pes_init_mass(stdin, 'a');
+	pes_init_mass(stdin, 'b');
+	pes_init_mass(stdin, 'c');
+
+	const double mass = pes_mass_abc(arrang);
+
+/*
+ *	Total angular momentum: anchors J_min, J_min + J_step, ..., up to J_max, are
+ *	the ones explicitly propagated, whereas all J up to J_extrap are summed:
+ */
+
+	const size_t J_min = read_int_keyword(stdin, "J_min", 0, 10000, 0);
+
+	const size_t J_max = read_int_keyword(stdin, "J_max", J_min, 10000, J_min);
+
+	const size_t J_step = read_int_keyword(stdin, "J_step", 1, 10000, 1);
+
+	const size_t J_extrap = read_int_keyword(stdin, "J_extrap", J_max, 10000, J_max);
+
+/*
+ *	Total energy grid (the same used by numerov):
+ */
+
+	const size_t coll_grid_size = read_int_keyword(stdin, "coll_grid_size", 1, 1000000, 100);
+
+	const double E_min = read_dbl_keyword(stdin, "E_min", -INF, INF, 0.0);
+
+	const double E_max = read_dbl_keyword(stdin, "E_max", E_min, INF, E_min);
+
+	const double E_step = (E_max - E_min)/as_double(coll_grid_size);
+
+/*
+ *	Initial and final rovibrational states:
+ */
+
+	const size_t v_in = read_int_keyword(stdin, "v_in", 0, 10000, 0);
+
+	const size_t j_in = read_int_keyword(stdin, "j_in", 0, 10000, 0);
+
+	const size_t v_out = read_int_keyword(stdin, "v_out", 0, 10000, v_in);
+
+	const size_t j_out = read_int_keyword(stdin, "j_out", 0, 10000, j_in);
+
+/*
+ *	Estimate of J not propagated: linear interpolation of the opacity in J (0) or
+ *	J-shifting (1). Above J_max, J-shifting is always used, with B = 1/(2 mass
+ *	shift_R^2) if shift_R > 0 or else fitted to the last two anchors:
+ */
+
+	const int mode = read_int_keyword(stdin, "extrap_mode", 0, 1, 0);
+
+	const double shift_R = read_dbl_keyword(stdin, "shift_R", 0.0, INF, 0.0);
+
+/*
+ *	Directories to read the basis functions and S matrices from:
+ */
+
+	char *b_dir = read_str_keyword(stdin, "basis_dir", ".");
+
+	char *s_dir = read_str_keyword(stdin, "ratio_dir", ".");
+
+/*
+ *	Opacity of all anchors:
+ */
+
+	const size_t max_anchor = (J_max - J_min)/J_step + 1;
+
+	size_t *J_anchor = allocate(max_anchor, sizeof(size_t), false);
+	double **p = allocate(max_anchor, sizeof(double *), false);
+
+	double level_in = INF;
+
+	for (size_t a = 0; a < max_anchor; ++a)
+	{
+		J_anchor[a] = J_min + a*J_step;
+		p[a] = allocate(coll_grid_size, sizeof(double), true);
+
+		const size_t max_channel = fgh_basis_count(b_dir, arrang, J_anchor[a]);
+
+		ASSERT(max_channel > 0)
+
+		fgh_basis *basis = allocate(max_channel, sizeof(fgh_basis), true);
+
+		for (size_t c = 0; c < max_channel; ++c)
+		{
+			fgh_basis_load(&basis[c], b_dir, arrang, c, J_anchor[a]);
+
+			if (basis[c].v == v_in && basis[c].j == j_in) level_in = basis[c].eigenval;
+		}
+
+		for (size_t n = 0; n < coll_grid_size; ++n)
+		{
+			const double E = E_min + as_double(n)*E_step;
+
+			p[a][n] = opacity(s_dir, arrang, J_anchor[a], n, E,
+			                  max_channel, basis, v_in, j_in, v_out, j_out);
+		}
+
+		for (size_t c = 0; c < max_channel; ++c)
+		{
+			if (basis[c].eigenvec != NULL) free(basis[c].eigenvec);
+			if (basis[c].weight != NULL) free(basis[c].weight);
+			if (basis[c].r != NULL) free(basis[c].r);
+		}
+
+		free(basis);
+	}
+
+	if (level_in == INF)
+	{
+		PRINT_ERROR("initial state v = %zu, j = %zu not found in the basis\n", v_in, j_in)
+		exit(EXIT_FAILURE);
+	}
+
+	double B = 0.0;
+
+	if (shift_R > 0.0)
+	{
+		B = 1.0/(2.0*mass*shift_R*shift_R);
+	}
+	else if (max_anchor > 1)
+	{
+		B = fit_shift(coll_grid_size, p[max_anchor - 2], p[max_anchor - 1],
+		              E_min, E_step, J_anchor[max_anchor - 2], J_anchor[max_anchor - 1]);
+	}
+	else if (J_extrap > J_max)
+	{
+		PRINT_ERROR("shift_R is needed for J-shifting from %zu anchor\n", max_anchor)
+		exit(EXIT_FAILURE);
+	}
+
+	printf("# Reduced mass = %f a.u., anchors = %zu, B = % -8e a.u.\n", mass, max_anchor, B);
+	printf("# Initial state: v = %zu, j = %zu, final state: v = %zu, j = %zu\n", v_in, j_in, v_out, j_out);
+
+/*
+ *	Error estimate: below the last anchor, each interior one is also estimated
+ *	without itself, as if not propagated, and the largest deviation from its
+ *	actual opacity bounds the one of each J interpolated. Above it, the last
+ *	anchor J-shifted from the one before bounds the one of each J extrapolated.
+ *	If not enough anchors are available, the error is printed as NaN:
+ */
+
+	const size_t J_last = J_anchor[max_anchor - 1];
+
+	if (J_step > 1 && max_anchor == 2)
+		printf("# WARNING: no interior anchor, interpolation error unavailable\n");
+
+	if (J_extrap > J_last && max_anchor == 1)
+		printf("# WARNING: a single anchor, extrapolation error unavailable\n");
+
+	printf("#      E (a.u.)     E_coll (a.u.)    sigma (a.u.)    error (a.u.)  sigma anchors (a.u.)\n");
+	printf("# ----------------------------------------------------------------------------------\n");
+
+	for (size_t n = 0; n < coll_grid_size; ++n)
+	{
+		const double E = E_min + as_double(n)*E_step;
+
+		if (E <= level_in) continue;
+
+		double error_in = (max_anchor < 3? NAN : 0.0);
+
+		for (size_t a = 1; (a + 1) < max_anchor; ++a)
+		{
+			const double x = estimate(mode, max_anchor, J_anchor, p,
+			                          coll_grid_size, E_min, E_step, n, B, J_anchor[a], a);
+
+			if (fabs(x - p[a][n]) > error_in) error_in = fabs(x - p[a][n]);
+		}
+
+		double error_ex = NAN;
+
+		if (max_anchor > 1)
+		{
+			const size_t a = max_anchor - 1;
+
+			const double x = j_shift(coll_grid_size, p[a - 1], E_min, E_step,
+			                         E, B, J_anchor[a - 1], J_anchor[a]);
+
+			error_ex = fabs(x - p[a][n]);
+		}
+
+		double sum = 0.0, sum_anchor = 0.0, sum_error = 0.0;
+
+		for (size_t J = J_min; J <= J_extrap; ++J)
+		{
+			const double weight = as_double(2*J + 1);
+
+			if (J <= J_max && (J - J_min)%J_step == 0)
+			{
+				const double x = p[(J - J_min)/J_step][n];
+
+				sum += weight*x;
+				sum_anchor += weight*x;
+			}
+			else
+			{
+				sum += weight*estimate(mode, max_anchor, J_anchor, p,
+				                       coll_grid_size, E_min, E_step, n, B, J, max_anchor);
+
+				sum_error += weight*(J < J_last? error_in : error_ex);
+			}
+		}
+
+		const double factor = M_PI/(2.0*mass*(E - level_in)*as_double(2*j_in + 1));
+
+		printf(FORMAT, E, E - level_in, factor*sum, factor*sum_error, factor*sum_anchor);
+	}
+
+	for (size_t a = 0; a < max_anchor; ++a)
+		free(p[a]);
+
+	free(p);
+	free(J_anchor);
+	free(s_dir);
+	free(b_dir);
+
+	return EXIT_SUCCESS;
+}
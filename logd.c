@@ -0,0 +1,702 @@
+#include "modules/pes.h"
+#include "modules/fgh.h"
+#include "modules/file.h"
+#include "modules/matrix.h"
+#include "modules/mpi_lib.h"
+#include "modules/johnson.h"
+#include "modules/manolopoulos.h"
+#include "modules/alexander.h"
+#include "modules/globals.h"
+
+#if !defined(COUPLING_MATRIX_FILE_FORMAT)
+	#define COUPLING_MATRIX_FILE_FORMAT "cmatrix_arrang=%c_n=%zu_J=%zu.bin"
+#endif
+
+#if !defined(K_MATRIX_FILE_FORMAT)
+	#define K_MATRIX_FILE_FORMAT "%s/kmatrix_arrang=%c_E=%zu_J=%zu.bin"
+#endif
+
+#define FORMAT "  %4zu    %4zu   %06f    %4zu    %4zu    %6zu    %6zu      %f\n"
+
+/******************************************************************************
+
+ Type window: the coupling matrices of four consecutive grid points, from first
+ to first + 3, of a uniform grid with grid_size points. It serves coupling() as
+ an interpolating source, keeping only four matrices in memory. Only the rows
+ and columns of the max_active channels listed in active are delivered, where
+ full is a workspace for the whole matrix.
+
+******************************************************************************/
+
+struct window
+{
+	char arrang;
+	size_t J, grid_size, first, max_active, *active;
+	double R_min, R_step;
+	matrix *v[4], *full;
+};
+
+/******************************************************************************
+
+ Function load_cmatrix(): read the coupling matrix from the disk for the n-th
+ grid point index, arrangement and total angular momentum J.
+
+******************************************************************************/
+
+inline static matrix *load_cmatrix(const char arrang, const size_t n, const size_t J)
+{
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, COUPLING_MATRIX_FILE_FORMAT, arrang, n, J);
+
+	return matrix_load(filename);
+}
+
+/******************************************************************************
+
+ Function window_move(): loads the coupling matrices from first to first + 3,
+ reusing those already in the window.
+
+******************************************************************************/
+
+void window_move(struct window *w, const size_t first)
+{
+	if (first == w->first && w->v[0] != NULL) return;
+
+	if (w->v[0] != NULL && first > w->first && first < w->first + 4)
+	{
+		const size_t shift = first - w->first;
+
+		for (size_t n = 0; n < shift; ++n)
+			matrix_free(w->v[n]);
+
+		for (size_t n = 0; n < 4 - shift; ++n)
+			w->v[n] = w->v[n + shift];
+
+		for (size_t n = 4 - shift; n < 4; ++n)
+			w->v[n] = load_cmatrix(w->arrang, first + n, w->J);
+	}
+	else
+	{
+		for (size_t n = 0; n < 4; ++n)
+		{
+			if (w->v[n] != NULL) matrix_free(w->v[n]);
+			w->v[n] = load_cmatrix(w->arrang, first + n, w->J);
+		}
+	}
+
+	w->first = first;
+}
+
+/******************************************************************************
+
+ Function coupling(): fills v with the coupling matrix at R, interpolated by a
+ four-point (cubic) Lagrange formula from the grid of coupling matrices, for the
+ active channels only.
+
+******************************************************************************/
+
+void coupling(const double R, matrix *v, void *params)
+{
+	struct window *w = (struct window *) params;
+
+	matrix *u = (w->max_active < matrix_rows(w->full)? w->full : v);
+
+	const double x = (R - w->R_min)/w->R_step;
+
+	size_t first = (x > 1.0? (size_t) x - 1 : 0);
+
+	if (first + 4 > w->grid_size) first = w->grid_size - 4;
+
+	window_move(w, first);
+
+	for (size_t n = 0; n < 4; ++n)
+	{
+		double weight = 1.0;
+
+		for (size_t m = 0; m < 4; ++m)
+			if (m != n) weight *= (x - as_double(first + m))/as_double((int) n - (int) m);
+
+		if (n == 0)
+			matrix_copy(u, w->v[n], weight, 0.0);
+		else
+			matrix_add(1.0, u, weight, w->v[n], u);
+	}
+
+	if (u == v) return;
+
+	for (size_t i = 0; i < w->max_active; ++i)
+		for (size_t j = 0; j < w->max_active; ++j)
+			matrix_set(v, i, j, matrix_get(u, w->active[i], w->active[j]));
+}
+
+/******************************************************************************
+
+ Function airy_start(): return the grid point index from which the off-diagonal
+ elements of all coupling matrices up to the last one are below max_coupling.
+ The grid is scanned backward, thus only the long-range matrices are loaded.
+
+******************************************************************************/
+
+size_t airy_start(const char arrang,
+                  const size_t J, const size_t grid_size, const double max_coupling)
+{
+	size_t n = grid_size;
+
+	while (n > 0)
+	{
+		matrix *v = load_cmatrix(arrang, n - 1, J);
+
+		double max_offdiag = 0.0;
+
+		for (size_t i = 0; i < matrix_rows(v); ++i)
+			for (size_t j = (i + 1); j < matrix_cols(v); ++j)
+				max_offdiag = fmax(max_offdiag, fabs(matrix_get(v, i, j)));
+
+		matrix_free(v);
+
+		if (max_offdiag > max_coupling) break;
+
+		--n;
+	}
+
+	return n;
+}
+
+/******************************************************************************
+
+ Function prune(): eliminates from the log derivative matrix y at R the active
+ channels e that are closed by a local wavenumber, kappa_e = sqrt[2m(V_ee - E)],
+ of at least min_kappa both at R and asymptotically, and whose couplings to all
+ other channels, |V_ej|, are below max_coupling. Assuming they just decay, y_e'
+ = -kappa_e y_e, beyond R, the Schur complement
+
+ Y = Y_kk - Y_ke (Y_ee + kappa_e)^-1 Y_ek
+
+ is the log derivative matrix of the channels k kept. Then, y and work are
+ replaced by new ones of reduced size and the active channels of w updated.
+ The number of channels eliminated is returned.
+
+ NOTE: at least one channel is always kept.
+
+******************************************************************************/
+
+size_t prune(const double R,
+             const double tot_energy,
+             const double mass,
+             const double min_kappa,
+             const double max_coupling,
+             const double level[],
+             struct window *w,
+             matrix **y,
+             johnson_workspace **work)
+{
+	const size_t max_ch = w->max_active;
+
+	matrix *v = matrix_alloc(max_ch, max_ch, false);
+
+	coupling(R, v, w);
+
+	size_t *keep = allocate(max_ch, sizeof(size_t), false);
+	size_t *elim = allocate(max_ch, sizeof(size_t), false);
+	double *kappa = allocate(max_ch, sizeof(double), false);
+
+	size_t max_keep = 0, max_elim = 0;
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		const double local = 2.0*mass*(matrix_get(v, i, i) - tot_energy);
+		const double asymp = 2.0*mass*(level[w->active[i]] - tot_energy);
+
+		double max_offdiag = 0.0;
+
+		for (size_t j = 0; j < max_ch; ++j)
+			if (j != i) max_offdiag = fmax(max_offdiag, fabs(matrix_get(v, i, j)));
+
+		if (fmin(local, asymp) >= min_kappa*min_kappa && max_offdiag <= max_coupling)
+		{
+			kappa[max_elim] = sqrt(local);
+			elim[max_elim++] = i;
+		}
+		else
+		{
+			keep[max_keep++] = i;
+		}
+	}
+
+	matrix_free(v);
+
+	if (max_elim == 0 || max_keep == 0)
+	{
+		free(keep);
+		free(elim);
+		free(kappa);
+		return 0;
+	}
+
+	matrix *y_ee = matrix_alloc(max_elim, max_elim, false);
+	matrix *y_ek = matrix_alloc(max_elim, max_keep, false);
+	matrix *y_ke = matrix_alloc(max_keep, max_elim, false);
+	matrix *y_kk = matrix_alloc(max_keep, max_keep, false);
+
+	for (size_t i = 0; i < max_elim; ++i)
+	{
+		for (size_t j = 0; j < max_elim; ++j)
+			matrix_set(y_ee, i, j, matrix_get(*y, elim[i], elim[j]));
+
+		matrix_incr(y_ee, i, i, kappa[i]);
+
+		for (size_t j = 0; j < max_keep; ++j)
+		{
+			matrix_set(y_ek, i, j, matrix_get(*y, elim[i], keep[j]));
+			matrix_set(y_ke, j, i, matrix_get(*y, keep[j], elim[i]));
+		}
+	}
+
+	for (size_t i = 0; i < max_keep; ++i)
+		for (size_t j = 0; j < max_keep; ++j)
+			matrix_set(y_kk, i, j, matrix_get(*y, keep[i], keep[j]));
+
+	matrix_solve(y_ee, y_ek, (*work)->pivot);
+
+	matrix_multiply_trans(-1.0, 'n', y_ke, 'n', y_ek, 1.0, y_kk);
+
+	for (size_t i = 0; i < max_keep; ++i)
+		w->active[i] = w->active[keep[i]];
+
+	w->max_active = max_keep;
+
+	matrix_free(*y);
+	*y = y_kk;
+
+	johnson_workspace_free(*work);
+	*work = johnson_workspace_alloc(max_keep);
+
+	matrix_free(y_ee);
+	matrix_free(y_ek);
+	matrix_free(y_ke);
+
+	free(keep);
+	free(elim);
+	free(kappa);
+
+	return max_elim;
+}
+
+/******************************************************************************
+
+ Function send_sector(): sends the four blocks of a (non-empty) global propagator
+ to the MPI process of rank to.
+
+******************************************************************************/
+
+void send_sector(const size_t to, const manolopoulos_sector *s)
+{
+	ASSERT(!s->empty)
+
+	matrix *block[4] = {s->y1, s->y2, s->y3, s->y4};
+
+	for (size_t n = 0; n < 4; ++n)
+	{
+		double *data = matrix_data_raw(block[n]);
+
+		mpi_send(to, matrix_data_length(block[n]), 'd', data);
+
+		free(data);
+	}
+}
+
+/******************************************************************************
+
+ Function receive_sector(): receives in s the four blocks sent by send_sector()
+ from the MPI process of rank from.
+
+ NOTE: matrix_data_raw() returns a copy, thus a buffer is used instead.
+
+******************************************************************************/
+
+void receive_sector(const size_t from, manolopoulos_sector *s)
+{
+	matrix *block[4] = {s->y1, s->y2, s->y3, s->y4};
+
+	const size_t length = matrix_data_length(s->y1);
+
+	double *data = allocate(length, sizeof(double), false);
+
+	for (size_t n = 0; n < 4; ++n)
+	{
+		mpi_receive(from, length, 'd', data);
+
+		for (size_t m = 0; m < length; ++m)
+			matrix_data_set(block[n], m, data[m]);
+	}
+
+	free(data);
+
+	s->empty = false;
+}
+
+/******************************************************************************
+
+ Function parallel_logd(): propagates y from R_min to R_max with all MPI processes
+ at a single total energy. The range is split in sectors of equal width, the
+ largest not above step, which do not depend on the number of processes. Each
+ process takes a contiguous range of whole sectors and builds its global
+ propagator, s[0]. These are then combined in a binary tree of log2(size)
+ levels: at level k, the process of rank r receives from r + 2^k, if r is
+ multiple of 2^(k + 1), or sends to r - 2^k and leaves, otherwise. Only process
+ 0 ends with y propagated, where s[1] is the buffer for the propagators
+ received. The total number of sectors is returned.
+
+******************************************************************************/
+
+size_t parallel_logd(const double R_min,
+                     const double R_max,
+                     const double tot_energy,
+                     const double mass,
+                     const double step,
+                     struct window *w,
+                     manolopoulos_sector *s[],
+                     matrix *y,
+                     johnson_workspace *work)
+{
+	const size_t rank = mpi_rank(), size = mpi_comm_size();
+
+	const size_t max_sector = (size_t) ceil((R_max - R_min)/step - 1.0E-10);
+
+	if (max_sector < size)
+	{
+		PRINT_ERROR("%zu sectors for %zu processes\n", max_sector, size)
+		exit(EXIT_FAILURE);
+	}
+
+	const double width = (R_max - R_min)/as_double(max_sector);
+
+	const size_t first = rank*max_sector/size, last = (rank + 1)*max_sector/size;
+
+	manolopoulos_sector_build(R_min + as_double(first)*width,
+	                          R_min + as_double(last)*width,
+	                          tot_energy, mass, width, w, coupling, s[0], work);
+
+	for (size_t stride = 1; stride < size; stride *= 2)
+	{
+		if (rank%(2*stride) != 0)
+		{
+			send_sector(rank - stride, s[0]);
+			break;
+		}
+
+		if (rank + stride < size)
+		{
+			receive_sector(rank + stride, s[1]);
+			manolopoulos_sector_combine(s[0], s[1], work);
+		}
+	}
+
+	if (rank == 0) manolopoulos_sector_apply(s[0], y, work);
+
+	return max_sector;
+}
+
+/******************************************************************************
+******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+	mpi_init(argc, argv);
+
+	file_init_stdin(argv[1]);
+
+/*
+ *	Arrangement (a = 1, b = 2, c = 3) and atomic masses:
+ */
+
+	const char arrang = 96 + read_int_keyword(stdin, "arrang", 1, 3, 1);
+
+	pes_init_mass(stdin, 'a');
+	pes_init_mass(stdin, 'b');
+	pes_init_mass(stdin, 'c');
+
+	const double mass = pes_mass_abc(arrang);
+
+/*
+ *	Total angular momentum, J:
+ */
+
+	const size_t J = read_int_keyword(stdin, "J", 0, 10000, 0);
+
+/*
+ *	Total energy grid:
+ */
+
+	const size_t coll_grid_size = read_int_keyword(stdin, "coll_grid_size", 1, 1000000, 100);
+
+	const double E_min = read_dbl_keyword(stdin, "E_min", -INF, INF, 0.0);
+
+	const double E_max = read_dbl_keyword(stdin, "E_max", E_min, INF, E_min);
+
+	const double E_step = (E_max - E_min)/as_double(coll_grid_size);
+
+/*
+ *	Scattering grid of the coupling matrices (the same used by numerov). The log
+ *	derivative is propagated from R_min up to the last grid point:
+ */
+
+	const size_t scatt_grid_size = read_int_keyword(stdin, "scatt_grid_size", 4, 1000000, 500);
+
+	const double R_min = read_dbl_keyword(stdin, "R_min", 0.0, INF, 0.5);
+
+	const double R_max = read_dbl_keyword(stdin, "R_max", R_min, INF, R_min + 30.0);
+
+	const double R_step = (R_max - R_min)/as_double(scatt_grid_size);
+
+	const double R_last = R_min + as_double(scatt_grid_size - 1)*R_step;
+
+/*
+ *	Sector width control: logd_step is the width of the first sector and, if
+ *	logd_tol > 0, widths are adjusted from an estimate of the quadrature error
+ *	(see manolopoulos_logd), otherwise kept fixed (default):
+ */
+
+	const double logd_step = read_dbl_keyword(stdin, "logd_step", 0.0, INF, 10.0*R_step);
+
+	const double logd_tol = read_dbl_keyword(stdin, "logd_tol", 0.0, 1.0, 0.0);
+
+/*
+ *	Long range: from airy_R up to the last grid point, the Airy propagator is
+ *	used with sector widths controlled by airy_tol (fixed if airy_tol = 0). If
+ *	airy_R is not given, it is taken as the grid point from which the coupling
+ *	matrices have all off-diagonal elements below airy_coupling (a.u.). Thus,
+ *	airy_R = R_max turns it off:
+ */
+
+	double airy_R = read_dbl_keyword(stdin, "airy_R", R_min, INF, -1.0);
+
+	const double airy_tol = read_dbl_keyword(stdin, "airy_tol", 0.0, 1.0, 1.0E-5);
+
+	const double airy_coupling = read_dbl_keyword(stdin, "airy_coupling", 0.0, INF, 1.0E-4);
+
+	if (airy_R < R_min)
+		airy_R = R_min + as_double(airy_start(arrang, J, scatt_grid_size, airy_coupling))*R_step;
+
+	airy_R = fmin(airy_R, R_last);
+
+/*
+ *	Closed-channel pruning: if prune_kappa > 0 (a.u.), every prune_step grid
+ *	points up to airy_R, channels closed by a local wavenumber of at least
+ *	prune_kappa and coupled to others by less than prune_coupling (a.u.) are
+ *	eliminated from the propagation, see prune():
+ */
+
+	const double prune_kappa = read_dbl_keyword(stdin, "prune_kappa", 0.0, INF, 0.0);
+
+	const double prune_coupling = read_dbl_keyword(stdin, "prune_coupling", 0.0, INF, 1.0E-4);
+
+	const size_t prune_step = read_int_keyword(stdin, "prune_step", 1, scatt_grid_size, 10);
+
+/*
+ *	Parallel in R: if parallel_R = 1, energies are not split among MPI processes.
+ *	Instead, each energy is propagated up to airy_R by all of them, see parallel_
+ *	logd(), with fixed sectors of width up to logd_step, the same for any number
+ *	of processes (logd_tol and pruning are not used). Process 0 then goes on
+ *	alone from airy_R:
+ */
+
+	const bool parallel_R = (bool) read_int_keyword(stdin, "parallel_R", 0, 1, 0);
+
+/*
+ *	Directories to read the basis functions from and to store K matrices:
+ */
+
+	char *b_dir = read_str_keyword(stdin, "basis_dir", ".");
+
+	char *k_dir = read_str_keyword(stdin, "kmatrix_dir", ".");
+
+/*
+ *	Asymptotic energy and angular momentum of each channel, from the basis:
+ */
+
+	const size_t max_channel = fgh_basis_count(b_dir, arrang, J);
+
+	ASSERT(max_channel > 0)
+
+	int *l = allocate(max_channel, sizeof(int), false);
+	double *level = allocate(max_channel, sizeof(double), false);
+
+	fgh_basis_channels(b_dir, arrang, J, max_channel, l, NULL, level);
+
+/*
+ *	Resolve all tasks:
+ */
+
+	if (mpi_rank() == 0)
+	{
+		printf("# MPI CPUs = %zu, num. of energies = %zu, num. of channels = %zu, R = [%f, %f], Airy from R = %f\n",
+		       mpi_comm_size(), coll_grid_size, max_channel, R_min, R_last, airy_R);
+
+		printf("#  CPU       E     energy (a.u.)     open    chan.    sectors      airy      wall time (s)\n");
+		printf("# ---------------------------------------------------------------------------------------\n");
+	}
+
+	size_t *active = allocate(max_channel, sizeof(size_t), false);
+
+	struct window w = {arrang, J, scatt_grid_size, 0, max_channel, active,
+	                   R_min, R_step, {NULL, NULL, NULL, NULL}, matrix_alloc(max_channel, max_channel, false)};
+
+	manolopoulos_sector *s[2] = {NULL, NULL};
+
+	if (parallel_R)
+	{
+		s[0] = manolopoulos_sector_alloc(max_channel);
+		s[1] = manolopoulos_sector_alloc(max_channel);
+	}
+	else
+	{
+		mpi_set_tasks(coll_grid_size);
+	}
+
+	const size_t first_task = (parallel_R? 0 : mpi_first_task());
+	const size_t last_task = (parallel_R? coll_grid_size - 1 : mpi_last_task());
+	const size_t extra_task = (parallel_R? 0 : mpi_extra_task());
+
+	for (size_t n = first_task; n <= last_task; ++n)
+	{
+		extra_step:
+		{
+			const double start_time = wall_time();
+
+			const double energy = E_min + as_double(n)*E_step;
+
+/*
+ *			NOTE: the wavefunction is assumed to vanish at R_min.
+ */
+
+			johnson_workspace *work = johnson_workspace_alloc(max_channel);
+
+			matrix *y = matrix_alloc(max_channel, max_channel, true);
+
+			for (size_t c = 0; c < max_channel; ++c)
+			{
+				active[c] = c;
+				matrix_set(y, c, c, 1.0E20);
+			}
+
+			w.max_active = max_channel;
+
+			double step = logd_step, R = R_min;
+
+			const double R_segment = (prune_kappa > 0.0? as_double(prune_step)*R_step : airy_R - R_min);
+
+			size_t sectors = 0, airy_sectors = 0;
+
+			if (parallel_R && airy_R > R_min)
+			{
+				sectors = parallel_logd(R_min, airy_R, energy, mass, logd_step, &w, s, y, work);
+
+				if (mpi_rank() > 0)
+				{
+					johnson_workspace_free(work);
+					matrix_free(y);
+					continue;
+				}
+
+				R = airy_R;
+			}
+
+			while (airy_R - R > 1.0E-12*R_step)
+			{
+				const double R_next = fmin(R + R_segment, airy_R);
+
+				sectors += manolopoulos_logd(R, R_next, energy, mass,
+				                             logd_tol, &step, &w, coupling, y, work);
+
+				if (prune_kappa > 0.0)
+					prune(R_next, energy, mass, prune_kappa, prune_coupling, level, &w, &y, &work);
+
+				R = R_next;
+			}
+
+			if (airy_R < R_last)
+				airy_sectors = alexander_airy(airy_R, R_last, energy, mass,
+				                              airy_tol, &step, &w, coupling, y, work);
+
+/*
+ *			NOTE: the K matrix elements of eliminated channels are set to zero.
+ */
+
+			matrix *k = NULL;
+
+			if (w.max_active < max_channel)
+			{
+				int *l_active = allocate(w.max_active, sizeof(int), false);
+				double *level_active = allocate(w.max_active, sizeof(double), false);
+
+				for (size_t c = 0; c < w.max_active; ++c)
+				{
+					l_active[c] = l[active[c]];
+					level_active[c] = level[active[c]];
+				}
+
+				matrix *k_active
+					= johnson_logd_kmatrix(l_active, energy, mass, level_active, y, R_last, work);
+
+				k = matrix_alloc(max_channel, max_channel, true);
+
+				for (size_t i = 0; i < w.max_active; ++i)
+					for (size_t j = 0; j < w.max_active; ++j)
+						matrix_set(k, active[i], active[j], matrix_get(k_active, i, j));
+
+				matrix_free(k_active);
+				free(level_active);
+				free(l_active);
+			}
+			else
+			{
+				k = johnson_logd_kmatrix(l, energy, mass, level, y, R_last, work);
+			}
+
+			johnson_workspace_free(work);
+			matrix_free(y);
+
+			char filename[MAX_LINE_LENGTH];
+			sprintf(filename, K_MATRIX_FILE_FORMAT, k_dir, arrang, n, J);
+
+			matrix_save(k, filename);
+			matrix_free(k);
+
+			size_t open = 0;
+
+			for (size_t c = 0; c < max_channel; ++c)
+				if (level[c] < energy) ++open;
+
+			const double end_time = wall_time();
+
+			printf(FORMAT, mpi_rank(), n, energy, open, w.max_active, sectors, airy_sectors, end_time - start_time);
+		}
+
+		if (n == last_task && extra_task > 0)
+		{
+			n = extra_task;
+			goto extra_step;
+		}
+	}
+
+	if (parallel_R)
+	{
+		manolopoulos_sector_free(s[0]);
+		manolopoulos_sector_free(s[1]);
+	}
+
+	for (size_t n = 0; n < 4; ++n)
+		if (w.v[n] != NULL) matrix_free(w.v[n]);
+
+	matrix_free(w.full);
+
+	free(active);
+	free(level);
+	free(l);
+	free(k_dir);
+	free(b_dir);
+
+	mpi_end();
+	return EXIT_SUCCESS;
+}
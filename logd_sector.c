@@ -0,0 +1,314 @@
+#include "modules/pes.h"
+#include "modules/fgh.h"
+#include "modules/file.h"
+#include "modules/matrix.h"
+#include "modules/mpi_lib.h"
+#include "modules/johnson.h"
+#include "modules/alexander.h"
+#include "modules/globals.h"
+
+#if !defined(COUPLING_MATRIX_FILE_FORMAT)
+	#define COUPLING_MATRIX_FILE_FORMAT "cmatrix_arrang=%c_n=%zu_J=%zu.bin"
+#endif
+
+#if !defined(K_MATRIX_FILE_FORMAT)
+	#define K_MATRIX_FILE_FORMAT "%s/kmatrix_arrang=%c_E=%zu_J=%zu.bin"
+#endif
+
+#define FORMAT "  %4zu    %4zu     %06f      %f\n"
+
+/******************************************************************************
+
+ Function load_cmatrix(): read the coupling matrix from the disk for the n-th
+ grid point index, arrangement and total angular momentum J.
+
+******************************************************************************/
+
+inline static matrix *load_cmatrix(const char arrang, const size_t n, const size_t J)
+{
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, COUPLING_MATRIX_FILE_FORMAT, arrang, n, J);
+
+	return matrix_load(filename);
+}
+
+/******************************************************************************
+
+ Function midpoint(): returns the grid point index at the midpoint of the k-th
+ sector, made of stride grid steps, which is the only one whose coupling matrix
+ is needed (see cmatrix_stride in a+d_cmatrix).
+
+******************************************************************************/
+
+inline static size_t midpoint(const size_t stride, const size_t k)
+{
+	return k*stride + stride/2;
+}
+
+/******************************************************************************
+
+ Function sector_basis(): diagonalizes the coupling matrix v at the midpoint
+ of a sector, V = T diag(eigenval) T^T, and sets the slopes of the adiabatic
+ channels from the coupling matrices at the midpoints of the previous, v_prev,
+ and next, v_next, sectors (null if none), a width apart. A central difference
+ is used if both are given, one-sided otherwise. The eigenvalues are returned
+ and T is stored in t.
+
+******************************************************************************/
+
+static double *sector_basis(const matrix *v_prev,
+                            const matrix *v,
+                            const matrix *v_next,
+                            const double width,
+                            const double mass,
+                            matrix *t,
+                            double slope[],
+                            johnson_workspace *work)
+{
+	double *eigenval = johnson_jcp78_eigen(v, t);
+
+	if (v_prev != NULL && v_next != NULL)
+		alexander_midpoint_slope(t, v_prev, v_next, 2.0*width, mass, slope, work);
+	else if (v_next != NULL)
+		alexander_midpoint_slope(t, v, v_next, width, mass, slope, work);
+	else if (v_prev != NULL)
+		alexander_midpoint_slope(t, v_prev, v, width, mass, slope, work);
+	else
+		for (size_t i = 0; i < matrix_rows(v); ++i) slope[i] = 0.0;
+
+	return eigenval;
+}
+
+/******************************************************************************
+******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+	mpi_init(argc, argv);
+
+	file_init_stdin(argv[1]);
+
+/*
+ *	Arrangement (a = 1, b = 2, c = 3) and atomic masses:
+ */
+
+	const char arrang = 96 + read_int_keyword(stdin, "arrang", 1, 3, 1);
+
+	pes_init_mass(stdin, 'a');
+	pes_init_mass(stdin, 'b');
+	pes_init_mass(stdin, 'c');
+
+	const double mass = pes_mass_abc(arrang);
+
+/*
+ *	Total angular momentum, J:
+ */
+
+	const size_t J = read_int_keyword(stdin, "J", 0, 10000, 0);
+
+/*
+ *	Total energy grid:
+ */
+
+	const size_t coll_grid_size = read_int_keyword(stdin, "coll_grid_size", 1, 1000000, 100);
+
+	const double E_min = read_dbl_keyword(stdin, "E_min", -INF, INF, 0.0);
+
+	const double E_max = read_dbl_keyword(stdin, "E_max", E_min, INF, E_min);
+
+	const double E_step = (E_max - E_min)/as_double(coll_grid_size);
+
+/*
+ *	Scattering grid of the coupling matrices (the same used by numerov):
+ */
+
+	const size_t scatt_grid_size = read_int_keyword(stdin, "scatt_grid_size", 2, 1000000, 500);
+
+	const double R_min = read_dbl_keyword(stdin, "R_min", 0.0, INF, 0.5);
+
+	const double R_max = read_dbl_keyword(stdin, "R_max", R_min, INF, R_min + 30.0);
+
+	const double R_step = (R_max - R_min)/as_double(scatt_grid_size);
+
+/*
+ *	Sectors: each one is sector_stride (even) grid steps wide, starting at R_min,
+ *	and only the coupling matrix at its midpoint is read. Thus, a+d_cmatrix may be
+ *	run with cmatrix_stride = sector_stride. The log derivative is matched at the
+ *	end of the last sector that fits in the grid:
+ */
+
+	const size_t stride = read_int_keyword(stdin, "sector_stride", 2, scatt_grid_size - 1, 10);
+
+	ASSERT(stride%2 == 0)
+
+	const size_t max_sector = (scatt_grid_size - 1)/stride;
+
+	const double width = as_double(stride)*R_step;
+
+	const double R_end = R_min + as_double(max_sector)*width;
+
+/*
+ *	Directories to read the basis functions from and to store K matrices:
+ */
+
+	char *b_dir = read_str_keyword(stdin, "basis_dir", ".");
+
+	char *k_dir = read_str_keyword(stdin, "kmatrix_dir", ".");
+
+/*
+ *	OpenMP: energies of each MPI process are propagated in parallel by threads,
+ *	each one with its own workspace, sharing the same sector basis.
+ */
+
+	const bool use_omp = (bool) read_int_keyword(stdin, "use_omp", 0, 1, 0);
+
+/*
+ *	Asymptotic energy and angular momentum of each channel, from the basis:
+ */
+
+	const size_t max_channel = fgh_basis_count(b_dir, arrang, J);
+
+	ASSERT(max_channel > 0)
+
+	int *l = allocate(max_channel, sizeof(int), false);
+	double *level = allocate(max_channel, sizeof(double), false);
+
+	fgh_basis_channels(b_dir, arrang, J, max_channel, l, NULL, level);
+
+/*
+ *	MPI: each process keeps in memory the log derivative matrices of its own
+ *	energies, including the extra one, if any, along the whole propagation.
+ */
+
+	mpi_set_tasks(coll_grid_size);
+
+	size_t max_energy = mpi_last_task() - mpi_first_task() + 1;
+
+	if (mpi_extra_task() > 0) ++max_energy;
+
+	size_t *list = allocate(max_energy, sizeof(size_t), false);
+	double *energy = allocate(max_energy, sizeof(double), false);
+	matrix **y = allocate(max_energy, sizeof(matrix *), false);
+
+/*
+ *	NOTE: the wavefunction is assumed to vanish at R_min.
+ */
+
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		list[m] = (m + mpi_first_task() <= mpi_last_task()? m + mpi_first_task() : mpi_extra_task());
+
+		energy[m] = E_min + as_double(list[m])*E_step;
+
+		y[m] = matrix_alloc(max_channel, max_channel, true);
+
+		for (size_t c = 0; c < max_channel; ++c)
+			matrix_set(y[m], c, c, 1.0E20);
+	}
+
+	const size_t max_workspace = (use_omp? (size_t) max_threads() : 1);
+
+	johnson_workspace **work = johnson_workspace_list(max_workspace, max_channel);
+
+	if (mpi_rank() == 0)
+	{
+		printf("# MPI CPUs = %zu, OpenMP threads = %d, num. of energies = %zu, num. of channels = %zu\n",
+		       mpi_comm_size(), max_threads(), coll_grid_size, max_channel);
+
+		printf("# Sectors = %zu, width = %f a.u. (%zu grid steps), R = [%f, %f]\n",
+		       max_sector, width, stride, R_min, R_end);
+
+		printf("#  CPU       n     R (a.u.)     wall time (s)\n");
+		printf("# ------------------------------------------\n");
+	}
+
+/*
+ *	Initially, y is in the basis of the coupling matrices, T_prev = I:
+ */
+
+	matrix *t = matrix_alloc(max_channel, max_channel, false);
+	matrix *t_prev = matrix_alloc(max_channel, max_channel, true);
+	matrix *overlap = matrix_alloc(max_channel, max_channel, false);
+
+	for (size_t c = 0; c < max_channel; ++c)
+		matrix_set(t_prev, c, c, 1.0);
+
+	double *slope = allocate(max_channel, sizeof(double), false);
+
+	matrix *v_prev = NULL, *v = load_cmatrix(arrang, midpoint(stride, 0), J), *v_next = NULL;
+
+	ASSERT(matrix_rows(v) == max_channel)
+
+	for (size_t k = 0; k < max_sector; ++k)
+	{
+		const double start_time = wall_time();
+
+		v_next = (k + 1 < max_sector? load_cmatrix(arrang, midpoint(stride, k + 1), J) : NULL);
+
+		double *eigenval = sector_basis(v_prev, v, v_next, width, mass, t, slope, work[0]);
+
+/*
+ *		Overlap between the bases of consecutive sectors, P = T_prev^T T:
+ */
+
+		matrix_multiply_trans(1.0, 't', t_prev, 'n', t, 0.0, overlap);
+
+		alexander_midpoint_step(width, mass, max_energy, energy,
+		                        eigenval, slope, overlap, y, work, use_omp);
+
+		free(eigenval);
+
+		matrix *swap = t_prev;
+		t_prev = t;
+		t = swap;
+
+		if (v_prev != NULL) matrix_free(v_prev);
+
+		v_prev = v;
+		v = v_next;
+
+		if (mpi_rank() == 0)
+			printf(FORMAT, mpi_rank(), midpoint(stride, k), R_min + (as_double(k) + 0.5)*width, wall_time() - start_time);
+	}
+
+	if (v_prev != NULL) matrix_free(v_prev);
+
+/*
+ *	Back to the basis of the coupling matrices, Y = T Y T^T, and K matrices:
+ */
+
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		matrix_multiply(1.0, t_prev, y[m], 0.0, t);
+		matrix_multiply_trans(1.0, 'n', t, 't', t_prev, 0.0, y[m]);
+
+		matrix *k = johnson_logd_kmatrix(l, energy[m], mass, level, y[m], R_end, work[0]);
+
+		char filename[MAX_LINE_LENGTH];
+		sprintf(filename, K_MATRIX_FILE_FORMAT, k_dir, arrang, list[m], J);
+
+		matrix_save(k, filename);
+		matrix_free(k);
+	}
+
+	for (size_t m = 0; m < max_energy; ++m)
+		matrix_free(y[m]);
+
+	johnson_workspace_list_free(max_workspace, work);
+
+	matrix_free(overlap);
+	matrix_free(t_prev);
+	matrix_free(t);
+
+	free(slope);
+	free(y);
+	free(energy);
+	free(list);
+	free(level);
+	free(l);
+	free(k_dir);
+	free(b_dir);
+
+	mpi_end();
+	return EXIT_SUCCESS;
+}
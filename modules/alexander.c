@@ -0,0 +1,484 @@
+/******************************************************************************
+
+ About
+ -----
+
+ This module is an implementation of the Airy propagator of M. H. Alexander and
+ D. E. Manolopoulos, Ref. [1], for the multichannel log derivative matrix Y. In
+ each sector, the potential is diagonalized at the midpoint and each adiabatic
+ channel is given a linear reference potential, for which the solutions are the
+ Airy functions Ai and Bi. Because the reference follows the potential closely
+ where it varies slowly, sectors can be much wider than those of the methods of
+ Ref. [2] and [3], which makes it the method of choice at long range.
+
+
+ References
+ ----------
+
+ [1] M. H. Alexander and D. E. Manolopoulos J. Chem. Phys. 86, 2044 (1987)
+     doi: https://doi.org/10.1063/1.452154
+
+ [2] D. E. Manolopoulos J. Chem. Phys. 85, 6425 (1986)
+     doi: https://doi.org/10.1063/1.451472
+
+ [3] B. R. Johnson. J. Comp. Phys. 13, 445 (1973)
+     doi: https://doi.org/10.1016/0021-9991(73)90049-1
+
+******************************************************************************/
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_sf_airy.h>
+
+#include "matrix.h"
+#include "johnson.h"
+#include "alexander.h"
+
+/******************************************************************************
+
+ Function constant_propagator(): computes the sector propagators y1, y2 = y3 and
+ y4 of a single channel for a constant reference potential w = 2m(V - E) and a
+ sector of width h.
+
+ NOTE: for kh -> 0, both k coth(kh) and k cot(kh) tend to 1/h + w*h/3, while
+ k/sinh(kh) and k/sin(kh) tend to 1/h - w*h/6.
+
+******************************************************************************/
+
+inline static void constant_propagator(const double h,
+                                       const double w,
+                                       double *y1, double *y2, double *y4)
+{
+	const double k = sqrt(fabs(w));
+
+	if (k*h < 1.0E-4)
+	{
+		*y1 = 1.0/h + w*h/3.0;
+		*y2 = 1.0/h - w*h/6.0;
+	}
+	else if (w > 0.0)
+	{
+		*y1 = k/tanh(k*h);
+		*y2 = k/sinh(k*h);
+	}
+	else
+	{
+		*y1 = k/tan(k*h);
+		*y2 = k/sin(k*h);
+	}
+
+	*y4 = *y1;
+}
+
+/******************************************************************************
+
+ Function airy_propagator(): computes the sector propagators y1, y2 = y3 and y4
+ of a single channel for the linear reference potential w + slope*(R - c), where
+ c is the midpoint of a sector of width h, from the solutions f = Ai(z) and g =
+ Bi(z), with z = alpha*(R - c) + w/alpha^2 and alpha^3 = slope:
+
+ y1 = -[f'(a) g(b) - g'(a) f(b)]/D,
+
+ y4 = [f(a) g'(b) - g(a) f'(b)]/D,
+
+ y2 = alpha/(pi D),
+
+ where D = f(a) g(b) - f(b) g(a) and alpha/pi is the Wronskian.
+
+ NOTE: the exponentially scaled Airy functions are used, and the common factor
+ exp(|zeta(b) - zeta(a)|), zeta = 2z^(3/2)/3, is cancelled out of D, avoiding
+ overflows in closed channels. The constant reference is used instead if slope
+ is so small that z is too large for the difference z(b) - z(a) to be resolved.
+
+******************************************************************************/
+
+static void airy_propagator(const double h,
+                            const double w,
+                            const double slope,
+                            double *y1, double *y2, double *y4)
+{
+	const double alpha = cbrt(slope);
+
+	if (alpha == 0.0 || fabs(w) > 1.0E4*alpha*alpha)
+	{
+		constant_propagator(h, w, y1, y2, y4);
+		return;
+	}
+
+	const double z_a = -0.5*alpha*h + w/(alpha*alpha);
+	const double z_b = 0.5*alpha*h + w/(alpha*alpha);
+
+	const double zeta_a = (z_a > 0.0? 2.0*pow(z_a, 1.5)/3.0 : 0.0);
+	const double zeta_b = (z_b > 0.0? 2.0*pow(z_b, 1.5)/3.0 : 0.0);
+
+	const double delta = zeta_b - zeta_a;
+	const double e1 = exp(delta - fabs(delta));
+	const double e2 = exp(-delta - fabs(delta));
+
+	const double f_a = gsl_sf_airy_Ai_scaled(z_a, GSL_PREC_DOUBLE);
+	const double f_b = gsl_sf_airy_Ai_scaled(z_b, GSL_PREC_DOUBLE);
+	const double g_a = gsl_sf_airy_Bi_scaled(z_a, GSL_PREC_DOUBLE);
+	const double g_b = gsl_sf_airy_Bi_scaled(z_b, GSL_PREC_DOUBLE);
+
+	const double f_prime_a = alpha*gsl_sf_airy_Ai_deriv_scaled(z_a, GSL_PREC_DOUBLE);
+	const double f_prime_b = alpha*gsl_sf_airy_Ai_deriv_scaled(z_b, GSL_PREC_DOUBLE);
+	const double g_prime_a = alpha*gsl_sf_airy_Bi_deriv_scaled(z_a, GSL_PREC_DOUBLE);
+	const double g_prime_b = alpha*gsl_sf_airy_Bi_deriv_scaled(z_b, GSL_PREC_DOUBLE);
+
+	const double d = f_a*g_b*e1 - f_b*g_a*e2;
+
+	*y1 = -(f_prime_a*g_b*e1 - g_prime_a*f_b*e2)/d;
+	*y4 = (f_a*g_prime_b*e1 - g_a*f_prime_b*e2)/d;
+	*y2 = alpha*exp(-fabs(delta))/(M_PI*d);
+}
+
+/******************************************************************************
+
+ Function diag_projection(): computes the diagonal of T^T v T, where T is the
+ matrix of eigenvectors (as columns) and x is a workspace.
+
+******************************************************************************/
+
+inline static void diag_projection(const matrix *t,
+                                   const matrix *v, matrix *x, double result[])
+{
+	const size_t max_ch = matrix_rows(v);
+
+	matrix_multiply(1.0, v, t, 0.0, x);
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		result[i] = 0.0;
+
+		for (size_t j = 0; j < max_ch; ++j)
+			result[i] += matrix_get(t, j, i)*matrix_get(x, j, i);
+	}
+}
+
+/******************************************************************************
+
+ Function alexander_airy(): propagates the log derivative matrix y from R_min to
+ R_max, for a given total energy and reduced mass, where pot_energy(R, v, params)
+ must fill v with the potential matrix at R (asymptotic energies and centrifugal
+ terms included). On entry, step is the width of the first sector and, on exit,
+ the width suggested for the next one. The number of sectors is returned.
+
+ In each sector [a, b] of width h and midpoint c, the potential V(c) = T diag(e)
+ T^T is diagonalized and the reference for the i-th adiabatic channel is linear,
+ with w_i = 2m(e_i - E) at c and slope given by the diagonal of 2m T^T [V(b) -
+ V(a)] T/h, as in Ref. [1]. The remaining coupling is neglected, but measured
+ to control the sector width: if tol > 0, a sector is accepted if
+
+ err = max(h|d_i|/(2q_i), h|u_ij|/(8 sqrt(q_i q_j)))
+
+ is below tol. Here, d_i is the deviation of the diagonal of T^T V T at c from
+ the average at a and b, u_ij the off-diagonal of 2m T^T [V(b) - V(a)] T, both
+ in terms of 2m(V - E), and q_i = max(sqrt|w_i|, 1/h), so that err is roughly
+ an error in the phase. The next width is scaled by 0.9(tol/err)^(1/3), within
+ the range [0.2, 2.0]. Otherwise, sectors of fixed width step are used.
+
+ NOTE: y is transformed into the local basis T of each sector by the overlap
+ between the bases of consecutive sectors, as in Ref. [1], and back to the
+ basis of pot_energy at the end. A workspace is allocated (and released) if
+ work = NULL.
+
+******************************************************************************/
+
+size_t alexander_airy(const double R_min,
+                      const double R_max,
+                      const double tot_energy,
+                      const double mass,
+                      const double tol,
+                      double *step,
+                      void *params,
+                      void (*pot_energy)(const double R, matrix *v, void *params),
+                      matrix *y,
+                      johnson_workspace *work)
+{
+	ASSERT(y != NULL)
+	ASSERT(step != NULL)
+	ASSERT(*step > 0.0)
+	ASSERT(R_max > R_min)
+	ASSERT(pot_energy != NULL)
+
+	const size_t max_ch = matrix_rows(y);
+
+	johnson_workspace *ws
+		= (work == NULL? johnson_workspace_alloc(max_ch) : work);
+
+	ASSERT(ws->max_ch == max_ch)
+
+	matrix *v_a = matrix_alloc(max_ch, max_ch, false);
+	matrix *v_b = matrix_alloc(max_ch, max_ch, false);
+	matrix *v_c = matrix_alloc(max_ch, max_ch, false);
+	matrix *u = matrix_alloc(max_ch, max_ch, false);
+
+	double *w = allocate(max_ch, sizeof(double), false);
+	double *slope = allocate(max_ch, sizeof(double), false);
+	double *mean = allocate(max_ch, sizeof(double), false);
+	double *y1 = allocate(max_ch, sizeof(double), false);
+	double *y2 = allocate(max_ch, sizeof(double), false);
+	double *y4 = allocate(max_ch, sizeof(double), false);
+
+	matrix *t = ws->a, *t_prev = ws->b, *x = ws->c, *p = ws->d;
+
+/*
+ *	Initially, y is in the basis of pot_energy:
+ */
+
+	matrix_set_zero(t_prev);
+
+	for (size_t i = 0; i < max_ch; ++i)
+		matrix_set(t_prev, i, i, 1.0);
+
+	pot_energy(R_min, v_a, params);
+
+	double R = R_min, h = *step, h_next = h;
+	size_t counter = 0;
+
+	while (R_max - R > 1.0E-12*(R_max - R_min))
+	{
+		h = fmin(h_next, R_max - R);
+
+		if (h < 1.0E-10*(R_max - R_min))
+		{
+			PRINT_ERROR("step too small (%e) at R = %f\n", h, R)
+			exit(EXIT_FAILURE);
+		}
+
+		pot_energy(R + 0.5*h, v_c, params);
+		pot_energy(R + h, v_b, params);
+
+		double *eigenval = johnson_jcp78_eigen(v_c, t);
+
+/*
+ *		Linear reference in the local basis, where u = 2m T^T [V(b) - V(a)] T:
+ */
+
+		matrix_add(1.0, v_b, -1.0, v_a, p);
+		matrix_multiply(1.0, p, t, 0.0, x);
+		matrix_multiply_trans(2.0*mass, 't', t, 'n', x, 0.0, u);
+
+		matrix_add(0.5, v_a, 0.5, v_b, p);
+		diag_projection(t, p, x, mean);
+
+		for (size_t i = 0; i < max_ch; ++i)
+		{
+			w[i] = 2.0*mass*(eigenval[i] - tot_energy);
+			slope[i] = matrix_get(u, i, i)/h;
+		}
+
+		free(eigenval);
+
+		bool accept = true;
+
+		if (tol > 0.0)
+		{
+			double err = 0.0;
+
+			for (size_t i = 0; i < max_ch; ++i)
+			{
+				const double q_i = fmax(sqrt(fabs(w[i])), 1.0/h);
+
+				const double d_i = 2.0*mass*(mean[i] - tot_energy) - w[i];
+
+				err = fmax(err, h*fabs(d_i)/(2.0*q_i));
+
+				for (size_t j = (i + 1); j < max_ch; ++j)
+				{
+					const double q_j = fmax(sqrt(fabs(w[j])), 1.0/h);
+
+					err = fmax(err, h*fabs(matrix_get(u, i, j))/(8.0*sqrt(q_i*q_j)));
+				}
+			}
+
+			accept = (err <= tol);
+
+			const double scale
+				= (err > 0.0? 0.9*pow(tol/err, 1.0/3.0) : 2.0);
+
+			h_next = h*fmin(2.0, fmax(0.2, scale));
+		}
+
+		if (!accept) continue;
+
+/*
+ *		Change of basis, Y = P^T Y P, with the overlap P = T_prev^T T:
+ */
+
+		matrix_multiply_trans(1.0, 't', t_prev, 'n', t, 0.0, p);
+		matrix_multiply(1.0, y, p, 0.0, x);
+		matrix_multiply_trans(1.0, 't', p, 'n', x, 0.0, y);
+
+/*
+ *		Sector propagation, Y = y4 - y3 (Y + y1)^-1 y2:
+ */
+
+		for (size_t i = 0; i < max_ch; ++i)
+			airy_propagator(h, w[i], slope[i], &y1[i], &y2[i], &y4[i]);
+
+		matrix_copy(x, y, 1.0, 0.0);
+
+		for (size_t i = 0; i < max_ch; ++i)
+			matrix_incr(x, i, i, y1[i]);
+
+		matrix_inverse_pivot(x, ws->pivot);
+
+		for (size_t i = 0; i < max_ch; ++i)
+		{
+			matrix_set_diag(y, i, y4[i] - y2[i]*matrix_get(x, i, i)*y2[i]);
+
+			for (size_t j = (i + 1); j < max_ch; ++j)
+				matrix_set_symm(y, i, j, -y2[i]*matrix_get(x, i, j)*y2[j]);
+		}
+
+		matrix *swap = t_prev;
+		t_prev = t;
+		t = swap;
+
+		swap = v_a;
+		v_a = v_b;
+		v_b = swap;
+
+		R += h;
+		++counter;
+	}
+
+/*
+ *	Back to the basis of pot_energy, Y = T Y T^T:
+ */
+
+	matrix_multiply(1.0, t_prev, y, 0.0, x);
+	matrix_multiply_trans(1.0, 'n', x, 't', t_prev, 0.0, y);
+
+	*step = h_next;
+
+	matrix_free(v_a);
+	matrix_free(v_b);
+	matrix_free(v_c);
+	matrix_free(u);
+
+	free(w);
+	free(slope);
+	free(mean);
+	free(y1);
+	free(y2);
+	free(y4);
+
+	if (work == NULL) johnson_workspace_free(ws);
+
+	return counter;
+}
+
+/******************************************************************************
+
+ Function alexander_midpoint_slope(): computes the slope of the linear reference
+ of each adiabatic channel of a sector, whose basis T (eigenvectors of V at the
+ midpoint, as columns) is t, from the potential matrices v_a and v_b at two
+ other radii, a distance apart (b > a), as the diagonal of 2m T^T [V(b) - V(a)]
+ T/distance. Unlike alexander_airy(), v_a and v_b may be the potentials at the
+ midpoints of the neighbouring sectors, thus no potential is needed at the
+ sector boundaries.
+
+******************************************************************************/
+
+void alexander_midpoint_slope(const matrix *t,
+                              const matrix *v_a,
+                              const matrix *v_b,
+                              const double distance,
+                              const double mass,
+                              double slope[],
+                              johnson_workspace *work)
+{
+	ASSERT(distance > 0.0)
+	ASSERT(work->max_ch == matrix_rows(t))
+
+	const size_t max_ch = matrix_rows(t);
+
+	matrix_add(1.0, v_b, -1.0, v_a, work->d);
+
+	diag_projection(t, work->d, work->c, slope);
+
+	for (size_t i = 0; i < max_ch; ++i)
+		slope[i] = 2.0*mass*slope[i]/distance;
+}
+
+/******************************************************************************
+
+ Function alexander_midpoint_step(): propagates the log derivative matrices y of
+ max_energy total energies across one sector of width h, where the potential is
+ diagonal in the local basis, with eigenvalues eigenval at the midpoint and the
+ slopes of alexander_midpoint_slope(). On entry, y is in the basis of the last
+ sector and overlap = T_prev^T T is the overlap between both bases; on exit, y
+ is in the basis of this sector. Since the basis, eigenvalues and slopes do not
+ depend on the energy, they are computed once by the caller for all energies.
+
+ If use_omp is true, energies are propagated in parallel by OpenMP threads, in
+ which case work[] holds one workspace per thread, max_threads(), otherwise
+ work[0] is used. With MAGMA, energies are always propagated sequentially, as
+ in johnson_jcp78_multi_numerov().
+
+******************************************************************************/
+
+void alexander_midpoint_step(const double h,
+                             const double mass,
+                             const size_t max_energy,
+                             const double tot_energy[],
+                             const double eigenval[],
+                             const double slope[],
+                             const matrix *overlap,
+                             matrix *y[],
+                             johnson_workspace *work[],
+                             const bool use_omp)
+{
+	ASSERT(h > 0.0)
+	ASSERT(work != NULL)
+	ASSERT(overlap != NULL)
+
+	const size_t max_ch = matrix_rows(overlap);
+
+	ASSERT(work[0]->max_ch == max_ch)
+
+	const bool use_threads = (use_omp && !matrix_using_magma());
+
+	#pragma omp parallel for default(none) shared(tot_energy, eigenval, slope, overlap, y, work) firstprivate(h, mass, max_energy, max_ch, use_threads) schedule(dynamic) if(use_threads)
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		johnson_workspace *ws = work[use_threads? thread_id() : 0];
+
+		matrix *x = ws->c;
+
+/*
+ *		Change of basis, Y = P^T Y P:
+ */
+
+		matrix_multiply(1.0, y[m], overlap, 0.0, x);
+		matrix_multiply_trans(1.0, 't', overlap, 'n', x, 0.0, y[m]);
+
+/*
+ *		Sector propagation, Y = y4 - y3 (Y + y1)^-1 y2:
+ */
+
+		double *y1 = ws->diag, *y2 = y1 + max_ch, *y4 = y2 + max_ch;
+
+		for (size_t i = 0; i < max_ch; ++i)
+		{
+			const double w = 2.0*mass*(eigenval[i] - tot_energy[m]);
+			airy_propagator(h, w, slope[i], &y1[i], &y2[i], &y4[i]);
+		}
+
+		matrix_copy(x, y[m], 1.0, 0.0);
+
+		for (size_t i = 0; i < max_ch; ++i)
+			matrix_incr(x, i, i, y1[i]);
+
+		matrix_inverse_pivot(x, ws->pivot);
+
+		for (size_t i = 0; i < max_ch; ++i)
+		{
+			matrix_set_diag(y[m], i, y4[i] - y2[i]*matrix_get(x, i, i)*y2[i]);
+
+			for (size_t j = (i + 1); j < max_ch; ++j)
+				matrix_set_symm(y[m], i, j, -y2[i]*matrix_get(x, i, j)*y2[j]);
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#if !defined(ALEXANDER_HEADER)
+	#define ALEXANDER_HEADER
+	#include "globals.h"
+	#include "matrix.h"
+	#include "johnson.h"
+
+	size_t alexander_airy(const double R_min,
+	                      const double R_max,
+	                      const double tot_energy,
+	                      const double mass,
+	                      const double tol,
+	                      double *step,
+	                      void *params,
+	                      void (*pot_energy)(const double R, matrix *v, void *params),
+	                      matrix *y,
+	                      johnson_workspace *work);
+
+	void alexander_midpoint_slope(const matrix *t,
+	                              const matrix *v_a,
+	                              const matrix *v_b,
+	                              const double distance,
+	                              const double mass,
+	                              double slope[],
+	                              johnson_workspace *work);
+
+	void alexander_midpoint_step(const double h,
+	                             const double mass,
+	                             const size_t max_energy,
+	                             const double tot_energy[],
+	                             const double eigenval[],
+	                             const double slope[],
+	                             const matrix *overlap,
+	                             matrix *y[],
+	                             johnson_workspace *work[],
+	                             const bool use_omp);
+#endif
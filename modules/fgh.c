@@ -19,6 +19,10 @@
 	#define FGH_BASIS_FORMAT "%s/basis_arrang=%c_ch=%zu_J=%zu.%s"
 #endif
 
+#if !defined(FGH_DROPPED_FORMAT)
+	#define FGH_DROPPED_FORMAT "%s/dropped_arrang=%c.dat"
+#endif
+
 /******************************************************************************
 
  Function fgh_matrix(): return the discrete variable representation (DVR) of a
@@ -28,6 +32,9 @@
  NOTE: The m-th eigenvector is the m-th column in a grid_size-by-grid_size row-
  major matrix: eigenvec[n*grid_size + m], where n = m = [0, grid_size).
 
+ NOTE: the box length L of Ref. [1] is the period of the grid, grid_size times
+ grid_step, not the distance between its first and last points.
+
 ******************************************************************************/
 
 matrix *fgh_dense_single_channel(const size_t grid_size,
@@ -38,7 +45,7 @@ matrix *fgh_dense_single_channel(const size_t grid_size,
 
 	matrix *result = matrix_alloc(grid_size, grid_size, false);
 
-	const double box_length = as_double(grid_size - 1)*grid_step;
+	const double box_length = as_double(grid_size)*grid_step;
 
 	const double factor = (M_PI*M_PI)/(mass*box_length*box_length);
 
@@ -79,7 +86,7 @@ matrix *fgh_dense_multi_channel(const size_t max_state,
 
 	matrix *result = matrix_alloc(grid_size*max_state, grid_size*max_state, false);
 
-	const double box_length = as_double(grid_size - 1)*grid_step;
+	const double box_length = as_double(grid_size)*grid_step;
 
 	const double factor = (M_PI*M_PI)/(mass*box_length*box_length);
 
@@ -151,7 +158,7 @@ mpi_matrix *fgh_sparse_multi_channel(const size_t max_state,
 
 	mpi_matrix *result = mpi_matrix_alloc(size, size, non_zeros);
 
-	const double box_length = as_double(grid_size - 1)*grid_step;
+	const double box_length = as_double(grid_size)*grid_step;
 
 	const double factor = (M_PI*M_PI)/(mass*box_length*box_length);
 
@@ -252,6 +259,412 @@ double fgh_interpolation(const size_t grid_size,
 	return result;
 }
 
+/******************************************************************************
+
+ Function fgh_mapped_grid(): computes the grid_size points r[n] in [r_min, r_max]
+ of a mapped Fourier grid, Ref. [4], where the local step is proportional to the
+ local de Broglie wavelength, 2pi/p(r), of a particle with a given mass and
+ energy in the rotationless potential pot_energy(0, r). The momentum is bounded
+ from below by 5% of its maximum, p(r)^2 = 2mass*(energy - V(r)) + p_min^2, in
+ order to keep a finite step in the classically forbidden regions. On exit,
+ jacobian[n] = dr/dx at each point, where x = [0, grid_size) is the uniform
+ auxiliary grid with unit step.
+
+******************************************************************************/
+
+void fgh_mapped_grid(const size_t grid_size,
+                     const double r_min,
+                     const double r_max,
+                     const double mass,
+                     const double energy,
+                     double (*pot_energy)(const size_t, const double),
+                     double r[],
+                     double jacobian[])
+{
+	ASSERT(grid_size > 1)
+	ASSERT(r_max > r_min)
+	ASSERT(pot_energy != NULL)
+
+/*
+ *	Local momentum on a fine uniform grid:
+ */
+
+	const size_t fine_size = 20*grid_size;
+	const double fine_step = (r_max - r_min)/as_double(fine_size - 1);
+
+	double *p = allocate(fine_size, sizeof(double), false);
+
+	double p_max = 0.0;
+	for (size_t i = 0; i < fine_size; ++i)
+	{
+		const double kinetic = energy - pot_energy(0, r_min + as_double(i)*fine_step);
+
+		p[i] = (kinetic > 0.0? sqrt(2.0*mass*kinetic) : 0.0);
+		if (p[i] > p_max) p_max = p[i];
+	}
+
+	const double p_min = (p_max > 0.0? 0.05*p_max : 1.0);
+
+	for (size_t i = 0; i < fine_size; ++i)
+		p[i] = sqrt(p[i]*p[i] + p_min*p_min);
+
+/*
+ *	Cumulative phase, phase(r) = int p(r') dr', and its inverse at the uniform x:
+ */
+
+	double *phase = allocate(fine_size, sizeof(double), true);
+
+	for (size_t i = 1; i < fine_size; ++i)
+		phase[i] = phase[i - 1] + 0.5*fine_step*(p[i - 1] + p[i]);
+
+	const double x_step = phase[fine_size - 1]/as_double(grid_size - 1);
+
+	size_t i = 0;
+	for (size_t n = 0; n < grid_size; ++n)
+	{
+		const double x = as_double(n)*x_step;
+
+		while (i < fine_size - 2 && phase[i + 1] < x) ++i;
+
+		const double t = (x - phase[i])/(phase[i + 1] - phase[i]);
+
+		r[n] = r_min + (as_double(i) + t)*fine_step;
+
+		jacobian[n] = x_step/(p[i] + t*(p[i + 1] - p[i]));
+	}
+
+	r[grid_size - 1] = r_max;
+
+	free(p);
+	free(phase);
+}
+
+/******************************************************************************
+
+ Function fgh_mapped_kinetic(): return the kinetic energy operator for a given
+ mass on the mapped grid built by fgh_mapped_grid(). Where, the Hermitian form
+ T = (1/2mass) J^-1/2 D^T J^-1 D J^-1/2 is used, J = diag(jacobian) and D the
+ sinc-DVR first derivative, D_nm = (-1)^(n - m)/(n - m), in the auxiliary grid
+ of unit step, as in Eq. (13) of Ref. [4].
+
+ NOTE: eigenvectors of T + V are the amplitudes sqrt(jacobian[n])*wavef(r[n]),
+ thus the respective quadrature weights are jacobian[n].
+
+******************************************************************************/
+
+matrix *fgh_mapped_kinetic(const size_t grid_size,
+                           const double jacobian[], const double mass)
+{
+	ASSERT(jacobian != NULL)
+
+	matrix *a = matrix_alloc(grid_size, grid_size, false);
+	matrix *a_t = matrix_alloc(grid_size, grid_size, false);
+
+	for (size_t n = 0; n < grid_size; ++n)
+	{
+		for (size_t m = 0; m < grid_size; ++m)
+		{
+			double d = 0.0;
+
+			if (n != m)
+			{
+				const double nm = as_double(n) - as_double(m);
+				d = ((n + m)%2 == 0? 1.0 : -1.0)/nm;
+			}
+
+			/* NOTE: a = J^-1/2 D J^-1/2, such that T = a^T a/2mass. */
+			d = d/sqrt(jacobian[n]*jacobian[m]);
+
+			matrix_set(a, n, m, d);
+			matrix_set(a_t, m, n, d);
+		}
+	}
+
+	matrix *result = matrix_alloc(grid_size, grid_size, false);
+
+	matrix_multiply(0.5/mass, a_t, a, 0.0, result);
+
+	matrix_free(a);
+	matrix_free(a_t);
+
+	return result;
+}
+
+/******************************************************************************
+
+ Function fgh_podvr(): return the Hamiltonian of a potential-optimized DVR with
+ grid_size points in the rotationless potential pot_energy(0, r), Ref. [5]. The
+ lowest grid_size eigenvectors of a primitive FGH with prim_grid_size uniform
+ points in [r_min, r_max) are used to diagonalize the position operator, whose
+ eigenvalues are the grid points r[n]. On exit, weight[n] = 1/u_n(r[n])^2 are
+ the quadrature weights, where u_n is the n-th DVR function.
+
+ NOTE: eigenvectors of the returned matrix (plus any other diagonal potential
+ at r[n]) are the amplitudes sqrt(weight[n])*wavef(r[n]).
+
+******************************************************************************/
+
+matrix *fgh_podvr(const size_t grid_size,
+                  const size_t prim_grid_size,
+                  const double r_min,
+                  const double r_max,
+                  const double mass,
+                  double (*pot_energy)(const size_t, const double),
+                  double r[],
+                  double weight[])
+{
+	ASSERT(grid_size > 0)
+	ASSERT(prim_grid_size > grid_size)
+	ASSERT(pot_energy != NULL)
+
+	const double prim_step = (r_max - r_min)/as_double(prim_grid_size);
+
+/*
+ *	Primitive FGH:
+ */
+
+	double *pot = allocate(prim_grid_size, sizeof(double), false);
+
+	for (size_t i = 0; i < prim_grid_size; ++i)
+		pot[i] = pot_energy(0, r_min + as_double(i)*prim_step);
+
+	matrix *prim = fgh_dense_single_channel(prim_grid_size, prim_step, pot, mass);
+
+	free(pot);
+
+	double *prim_eigenval = matrix_symm_eigen(prim, 'v');
+
+	double **chi = allocate(grid_size, sizeof(double *), false);
+
+	for (size_t k = 0; k < grid_size; ++k)
+	{
+		if (matrix_using_magma())
+			chi[k] = matrix_get_raw_row(prim, k);
+		else
+			chi[k] = matrix_get_raw_col(prim, k);
+	}
+
+	matrix_free(prim);
+
+/*
+ *	Position operator in the basis of the lowest eigenvectors:
+ */
+
+	matrix *x = matrix_alloc(grid_size, grid_size, false);
+
+	for (size_t k = 0; k < grid_size; ++k)
+	{
+		for (size_t l = k; l < grid_size; ++l)
+		{
+			double sum = 0.0;
+			for (size_t i = 0; i < prim_grid_size; ++i)
+				sum += chi[k][i]*(r_min + as_double(i)*prim_step)*chi[l][i];
+
+			matrix_set_symm(x, k, l, sum);
+		}
+	}
+
+	double *point = matrix_symm_eigen(x, 'v');
+
+/*
+ *	DVR functions, u_n(r) = sum_k U_kn chi_k(r), at their own points and with
+ *	the sign chosen such that u_n(r[n]) > 0:
+ */
+
+	for (size_t k = 0; k < grid_size; ++k)
+		for (size_t i = 0; i < prim_grid_size; ++i)
+			chi[k][i] /= sqrt(prim_step);
+
+	matrix *u = matrix_alloc(grid_size, grid_size, false);
+
+	for (size_t n = 0; n < grid_size; ++n)
+	{
+		r[n] = point[n];
+
+		double u_n = 0.0;
+		for (size_t k = 0; k < grid_size; ++k)
+		{
+			const double u_kn
+				= (matrix_using_magma()? matrix_get(x, n, k) : matrix_get(x, k, n));
+
+			matrix_set(u, k, n, u_kn);
+
+			u_n += u_kn*fgh_interpolation(prim_grid_size, chi[k], r_min, r_max, r[n]);
+		}
+
+		if (u_n < 0.0)
+		{
+			for (size_t k = 0; k < grid_size; ++k)
+				matrix_scale(u, k, n, -1.0);
+		}
+
+		weight[n] = 1.0/(u_n*u_n);
+	}
+
+/*
+ *	Hamiltonian in the DVR: H_nm = sum_k U_kn E_k U_km
+ */
+
+	matrix *result = matrix_alloc(grid_size, grid_size, false);
+
+	for (size_t n = 0; n < grid_size; ++n)
+	{
+		for (size_t m = n; m < grid_size; ++m)
+		{
+			double sum = 0.0;
+			for (size_t k = 0; k < grid_size; ++k)
+				sum += matrix_get(u, k, n)*prim_eigenval[k]*matrix_get(u, k, m);
+
+			matrix_set_symm(result, n, m, sum);
+		}
+	}
+
+	for (size_t k = 0; k < grid_size; ++k)
+		free(chi[k]);
+
+	free(chi);
+	free(point);
+	free(prim_eigenval);
+	matrix_free(x);
+	matrix_free(u);
+
+	return result;
+}
+
+/******************************************************************************
+
+ Function fgh_kernel_alloc(): precomputes the weights of Eq. (4.1) of Ref. [3]
+ that resample eigenvectors from a uniform grid in [r_min, r_max] with grid_size
+ points onto a new uniform grid in [new_r_min, new_r_max] with new_grid_size
+ points. Since sin(pi(x - n)) = (-1)^n sin(pi x), only one sin() is needed for
+ each new point. If width > 0 the sum is truncated to the 2*width old points
+ around each new one and the sinc is tapered by a Gaussian of variance width/4,
+ otherwise (width = 0) the full sum of fgh_interpolation() is kept.
+
+ NOTE: width = 16 already reproduces the full sum to about 1.0E-9 for smooth
+ bound states.
+
+******************************************************************************/
+
+fgh_kernel *fgh_kernel_alloc(const size_t grid_size,
+                             const double r_min,
+                             const double r_max,
+                             const size_t new_grid_size,
+                             const double new_r_min,
+                             const double new_r_max,
+                             const size_t width)
+{
+	ASSERT(grid_size > 0)
+	ASSERT(new_grid_size > 0)
+
+	fgh_kernel *k = allocate(1, sizeof(fgh_kernel), true);
+
+	k->grid_size = grid_size;
+	k->new_grid_size = new_grid_size;
+	k->band = (width == 0 || 2*width > grid_size? grid_size : 2*width);
+
+	k->first = allocate(new_grid_size, sizeof(size_t), true);
+	k->weight = allocate(new_grid_size*k->band, sizeof(double), true);
+
+	const double r_step = (r_max - r_min)/as_double(grid_size);
+	const double new_r_step = (new_r_max - new_r_min)/as_double(new_grid_size);
+
+	const double taper = (k->band < grid_size? 4.0/as_double(width) : 0.0);
+
+	for (size_t m = 0; m < new_grid_size; ++m)
+	{
+		const double x = (new_r_min + as_double(m)*new_r_step - r_min)/r_step;
+
+		if (k->band < grid_size)
+		{
+			const double n_min = floor(x) + 1.0 - as_double(width);
+			const double n_max = as_double(grid_size - k->band);
+
+			if (n_min > n_max)
+				k->first[m] = grid_size - k->band;
+			else
+				k->first[m] = (n_min > 0.0? (size_t) n_min : 0);
+		}
+
+		const double sin_x = sin(M_PI*x);
+
+		for (size_t b = 0; b < k->band; ++b)
+		{
+			const size_t n = k->first[m] + b;
+			const double param = M_PI*(x - as_double(n));
+
+			double w = 1.0;
+
+			if (fabs(param) > 1.0E-7)
+				w = (n%2 == 0? sin_x : -sin_x)/param;
+
+			if (taper > 0.0)
+				w *= exp(-0.5*taper*(x - as_double(n))*(x - as_double(n)));
+
+			k->weight[m*k->band + b] = w;
+		}
+	}
+
+	return k;
+}
+
+/******************************************************************************
+
+ Function fgh_kernel_free(): release resources allocated by fgh_kernel_alloc().
+
+******************************************************************************/
+
+void fgh_kernel_free(fgh_kernel *k)
+{
+	ASSERT(k != NULL)
+
+	free(k->first);
+	free(k->weight);
+	free(k);
+}
+
+/******************************************************************************
+
+ Function fgh_kernel_apply(): resample the eigenvectors of max_state channels
+ at once, i.e. the banded product of the kernel (new_grid_size-by-grid_size)
+ with the grid_size-by-max_state matrix of eigenvectors, where each column is
+ resampled in parallel.
+
+ NOTE: new_eigenvec[c] shall have room for at least new_grid_size points.
+
+******************************************************************************/
+
+void fgh_kernel_apply(const fgh_kernel *k,
+                      const size_t max_state,
+                      double *eigenvec[],
+                      double *new_eigenvec[])
+{
+	ASSERT(k != NULL)
+	ASSERT(eigenvec != NULL)
+	ASSERT(new_eigenvec != NULL)
+
+	const size_t band = k->band;
+	const size_t new_grid_size = k->new_grid_size;
+
+	#pragma omp parallel for default(none) shared(k, eigenvec, new_eigenvec) firstprivate(max_state, band, new_grid_size) schedule(static) if(max_state > 1)
+	for (size_t c = 0; c < max_state; ++c)
+	{
+		const double *old = eigenvec[c];
+
+		for (size_t m = 0; m < new_grid_size; ++m)
+		{
+			const double *w = &k->weight[m*band];
+			const double *y = &old[k->first[m]];
+
+			double sum = 0.0;
+			for (size_t b = 0; b < band; ++b)
+				sum += w[b]*y[b];
+
+			new_eigenvec[c][m] = sum;
+		}
+	}
+}
+
 /******************************************************************************
 
  Function dvr_fgh_product(): the same of dvr_fgh_wavef() but for the product of
@@ -298,28 +711,18 @@ double dvr_fgh_product(const matrix *fgh, const int a, const int b,
 
 /******************************************************************************
 
- Function fgh_eigenvec(): normalize to unity the eigenvector v of a Hamiltonian
- built by fgh_dense_single_channel(). On entry, the matrix is expected to be
- properly diagonalized with its columns being the respective eigenvectors.
+ Function fgh_normalize(): normalize to unity, using a 1/3-Simpson quadrature
+ rule, an eigenvector of grid_size points built on a uniform grid.
 
 ******************************************************************************/
 
-double *fgh_eigenvec(const matrix *fgh, const size_t v, const double grid_step)
+void fgh_normalize(const size_t grid_size,
+                   double eigenvec[], const double grid_step)
 {
-	ASSERT(fgh != NULL)
+	ASSERT(eigenvec != NULL)
 
-	const size_t grid_size = matrix_rows(fgh);
 	const size_t n_max = (grid_size%2 == 0? grid_size : grid_size - 1);
 
-	double *eigenvec = NULL;
-
-	if (matrix_using_magma())
-		eigenvec = matrix_get_raw_row(fgh, v);
-	else
-		eigenvec = matrix_get_raw_col(fgh, v);
-
-	ASSERT(eigenvec != NULL)
-
 	double sum
 		= eigenvec[0]*eigenvec[0] + eigenvec[n_max - 1]*eigenvec[n_max - 1];
 
@@ -332,6 +735,30 @@ double *fgh_eigenvec(const matrix *fgh, const size_t v, const double grid_step)
 
 	for (size_t n = 0; n < grid_size; ++n)
 		eigenvec[n] = norm*eigenvec[n];
+}
+
+/******************************************************************************
+
+ Function fgh_eigenvec(): normalize to unity the eigenvector v of a Hamiltonian
+ built by fgh_dense_single_channel(). On entry, the matrix is expected to be
+ properly diagonalized with its columns being the respective eigenvectors.
+
+******************************************************************************/
+
+double *fgh_eigenvec(const matrix *fgh, const size_t v, const double grid_step)
+{
+	ASSERT(fgh != NULL)
+
+	double *eigenvec = NULL;
+
+	if (matrix_using_magma())
+		eigenvec = matrix_get_raw_row(fgh, v);
+	else
+		eigenvec = matrix_get_raw_col(fgh, v);
+
+	ASSERT(eigenvec != NULL)
+
+	fgh_normalize(matrix_rows(fgh), eigenvec, grid_step);
 
 	return eigenvec;
 }
@@ -490,6 +917,47 @@ FILE *fgh_basis_file(const char dir[], const char arrang, const size_t n,
 	return stream;
 }
 
+/******************************************************************************
+
+ Function fgh_basis_trim(): removes from the disk the FGH basis functions of a
+ given arrangement and total angular momentum J, from the n-th channel onward,
+ left by previous runs. Thus, fgh_basis_count() returns n afterwards.
+
+******************************************************************************/
+
+void fgh_basis_trim(const char dir[],
+                    const char arrang, const size_t n, const size_t J)
+{
+	char filename[MAX_LINE_LENGTH];
+
+	size_t counter = n;
+	sprintf(filename, FGH_BASIS_FORMAT, dir, arrang, counter, J, "bin");
+
+	while (file_exist(filename))
+	{
+		file_remove(filename);
+
+		++counter;
+		sprintf(filename, FGH_BASIS_FORMAT, dir, arrang, counter, J, "bin");
+	}
+}
+
+/******************************************************************************
+
+ Function fgh_dropped_file(): opens the text file that lists the channels of a
+ given arrangement left out of the basis by an energy cutoff. Where, mode is
+ the file access mode of fopen() from the C library.
+
+******************************************************************************/
+
+FILE *fgh_dropped_file(const char dir[], const char arrang, const char mode[])
+{
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, FGH_DROPPED_FORMAT, dir, arrang);
+
+	return file_open(filename, mode);
+}
+
 /******************************************************************************
 
  Function fgh_basis_write(): saves in the disk the FGH basis function for the
@@ -515,6 +983,18 @@ void fgh_basis_write(const fgh_basis *b, FILE *output)
 	file_write(&b->grid_size, sizeof(size_t), 1, output);
 
 	file_write(b->eigenvec, sizeof(double), b->grid_size, output);
+
+	/* NOTE: grid points and weights are only needed for non-uniform grids. */
+	if (b->r_step == 0.0)
+	{
+		ASSERT(b->r != NULL)
+		ASSERT(b->weight != NULL)
+
+		file_write(b->r, sizeof(double), b->grid_size, output);
+		file_write(b->weight, sizeof(double), b->grid_size, output);
+	}
+
+	file_write(&b->omega, sizeof(size_t), 1, output);
 }
 
 /******************************************************************************
@@ -544,6 +1024,25 @@ void fgh_basis_read(fgh_basis *b, FILE *input)
 	b->eigenvec = allocate(b->grid_size, sizeof(double), false);
 
 	file_read(b->eigenvec, sizeof(double), b->grid_size, input, 0);
+
+	b->r = NULL;
+	b->weight = NULL;
+
+	if (b->r_step == 0.0)
+	{
+		b->r = allocate(b->grid_size, sizeof(double), false);
+		b->weight = allocate(b->grid_size, sizeof(double), false);
+
+		file_read(b->r, sizeof(double), b->grid_size, input, 0);
+		file_read(b->weight, sizeof(double), b->grid_size, input, 0);
+	}
+
+/*
+ *	NOTE: the helicity is a trailer absent in files of older versions, which are
+ *	read as omega = 0.
+ */
+
+	if (fread(&b->omega, sizeof(size_t), 1, input) != 1) b->omega = 0;
 }
 
 /******************************************************************************
@@ -579,3 +1078,40 @@ void fgh_basis_load(fgh_basis *b, const char dir[],
 
 	file_close(&input);
 }
+
+/******************************************************************************
+
+ Function fgh_basis_channels(): loads from the disk the orbital angular momentum
+ l, helicity omega and asymptotic energy level of the first max_channel basis
+ functions of a given arrangement and total angular momentum J, as needed to
+ match scattering solutions, discarding their eigenvectors. Where, omega may be
+ null if not needed.
+
+******************************************************************************/
+
+void fgh_basis_channels(const char dir[],
+                        const char arrang,
+                        const size_t J,
+                        const size_t max_channel,
+                        int l[],
+                        size_t omega[],
+                        double level[])
+{
+	ASSERT(l != NULL)
+	ASSERT(level != NULL)
+
+	for (size_t n = 0; n < max_channel; ++n)
+	{
+		fgh_basis basis;
+		fgh_basis_load(&basis, dir, arrang, n, J);
+
+		l[n] = (int) basis.l;
+		level[n] = basis.eigenval;
+
+		if (omega != NULL) omega[n] = basis.omega;
+
+		if (basis.eigenvec != NULL) free(basis.eigenvec);
+		if (basis.weight != NULL) free(basis.weight);
+		if (basis.r != NULL) free(basis.r);
+	}
+}
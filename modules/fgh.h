@@ -10,16 +10,41 @@
 	 asymptotic rovibrational FGH states (single channel, n = 0, or multichannel,
 	 n > 0).
 
+	 NOTE: r_step = 0 stands for a non-uniform grid (mapped or potential-optimized)
+	 with points r[n] and quadrature weights weight[n], such that the eigenvector
+	 is normalized as sum_n weight[n]*eigenvec[n]^2 = 1. Otherwise, both r and
+	 weight are null.
+
+	 NOTE: omega is the body-fixed helicity of a coupled-states (CS) channel, for
+	 which l is the effective orbital quantum number (l = J). It is zero and not
+	 used otherwise.
+
 	******************************************************************************/
 
 	struct fgh_basis
 	{
-		size_t v, j, l, n, grid_size;
-		double r_min, r_max, r_step, eigenval, *eigenvec;
+		size_t v, j, l, n, omega, grid_size;
+		double r_min, r_max, r_step, eigenval, *eigenvec, *r, *weight;
 	};
 
 	typedef struct fgh_basis fgh_basis;
 
+	/******************************************************************************
+
+	 Type fgh_kernel: represents the sinc weights that resample eigenvectors from
+	 a uniform grid of grid_size points onto another of new_grid_size points. Each
+	 new point m uses band old points, starting from first[m].
+
+	******************************************************************************/
+
+	struct fgh_kernel
+	{
+		size_t grid_size, new_grid_size, band, *first;
+		double *weight;
+	};
+
+	typedef struct fgh_kernel fgh_kernel;
+
 	matrix *fgh_dense_single_channel(const size_t grid_size,
 	                                 const double grid_step,
 	                                 const double pot_energy[],
@@ -43,6 +68,45 @@
 	                         const double r_max,
 	                         const double r_new);
 
+	void fgh_mapped_grid(const size_t grid_size,
+	                     const double r_min,
+	                     const double r_max,
+	                     const double mass,
+	                     const double energy,
+	                     double (*pot_energy)(const size_t, const double),
+	                     double r[],
+	                     double jacobian[]);
+
+	matrix *fgh_mapped_kinetic(const size_t grid_size,
+	                           const double jacobian[], const double mass);
+
+	matrix *fgh_podvr(const size_t grid_size,
+	                  const size_t prim_grid_size,
+	                  const double r_min,
+	                  const double r_max,
+	                  const double mass,
+	                  double (*pot_energy)(const size_t, const double),
+	                  double r[],
+	                  double weight[]);
+
+	fgh_kernel *fgh_kernel_alloc(const size_t grid_size,
+	                             const double r_min,
+	                             const double r_max,
+	                             const size_t new_grid_size,
+	                             const double new_r_min,
+	                             const double new_r_max,
+	                             const size_t width);
+
+	void fgh_kernel_free(fgh_kernel *k);
+
+	void fgh_kernel_apply(const fgh_kernel *k,
+	                      const size_t max_state,
+	                      double *eigenvec[],
+	                      double *new_eigenvec[]);
+
+	void fgh_normalize(const size_t grid_size,
+	                   double eigenvec[], const double grid_step);
+
 	double *fgh_eigenvec(const matrix *fgh,
 	                     const size_t v, const double grid_step);
 
@@ -57,6 +121,11 @@
 	FILE *fgh_basis_file(const char dir[], const char arrang, const size_t n,
 	                     const size_t J, const char mode[], const bool verbose);
 
+	void fgh_basis_trim(const char dir[],
+	                    const char arrang, const size_t n, const size_t J);
+
+	FILE *fgh_dropped_file(const char dir[], const char arrang, const char mode[]);
+
 	void fgh_basis_write(const fgh_basis *b, FILE *output);
 
 	void fgh_basis_read(fgh_basis *b, FILE *input);
@@ -66,4 +135,12 @@
 
 	void fgh_basis_load(fgh_basis *b, const char dir[],
 	                    const char arrang, const size_t n, const size_t J);
+
+	void fgh_basis_channels(const char dir[],
+	                        const char arrang,
+	                        const size_t J,
+	                        const size_t max_channel,
+	                        int l[],
+	                        size_t omega[],
+	                        double level[]);
 #endif
@@ -45,6 +45,122 @@ inline static double centr_term(const int l,
 	return as_double(l*(l + 1))/(2.0*mass*x*x);
 }
 
+/******************************************************************************
+
+ Function johnson_workspace_alloc(): allocate the scratch matrices, pivots and
+ diagonal buffers (3*max_ch) used by the propagation steps of this module for
+ max_ch channels. Passing it to each step avoids any heap allocation inside the
+ propagation loop.
+
+******************************************************************************/
+
+johnson_workspace *johnson_workspace_alloc(const size_t max_ch)
+{
+	ASSERT(max_ch > 0)
+
+	johnson_workspace *work = allocate(1, sizeof(johnson_workspace), true);
+
+	work->max_ch = max_ch;
+
+	work->a = matrix_alloc(max_ch, max_ch, false);
+	work->b = matrix_alloc(max_ch, max_ch, false);
+	work->c = matrix_alloc(max_ch, max_ch, false);
+	work->d = matrix_alloc(max_ch, max_ch, false);
+
+	work->pivot = matrix_pivot_alloc(max_ch);
+
+	work->diag = allocate(3*max_ch, sizeof(double), false);
+
+	return work;
+}
+
+/******************************************************************************
+
+ Function johnson_workspace_free(): release resources allocated by
+ johnson_workspace_alloc().
+
+******************************************************************************/
+
+void johnson_workspace_free(johnson_workspace *work)
+{
+	matrix_free(work->a);
+	matrix_free(work->b);
+	matrix_free(work->c);
+	matrix_free(work->d);
+
+	matrix_pivot_free(work->pivot);
+
+	free(work->diag);
+	free(work);
+}
+
+/******************************************************************************
+
+ Function johnson_workspace_list(): allocates max_workspace workspaces for max_ch
+ channels, e.g. one per OpenMP thread for the work[] of johnson_jcp78_multi_
+ numerov() and johnson_multi_kmatrix().
+
+******************************************************************************/
+
+johnson_workspace **johnson_workspace_list(const size_t max_workspace,
+                                           const size_t max_ch)
+{
+	ASSERT(max_workspace > 0)
+
+	johnson_workspace **work
+		= allocate(max_workspace, sizeof(johnson_workspace *), false);
+
+	for (size_t n = 0; n < max_workspace; ++n)
+		work[n] = johnson_workspace_alloc(max_ch);
+
+	return work;
+}
+
+/******************************************************************************
+
+ Function johnson_workspace_list_free(): release resources allocated by
+ johnson_workspace_list().
+
+******************************************************************************/
+
+void johnson_workspace_list_free(const size_t max_workspace,
+                                 johnson_workspace *work[])
+{
+	for (size_t n = 0; n < max_workspace; ++n)
+		johnson_workspace_free(work[n]);
+
+	free(work);
+}
+
+/******************************************************************************
+
+ Function workspace_init(): returns the workspace given by the caller, checking
+ its size, or a new one for max_ch channels if work = NULL. In the latter case
+ it must be released by workspace_end().
+
+******************************************************************************/
+
+inline static johnson_workspace *workspace_init(johnson_workspace *work,
+                                                const size_t max_ch)
+{
+	if (work == NULL) return johnson_workspace_alloc(max_ch);
+
+	ASSERT(work->max_ch == max_ch)
+
+	return work;
+}
+
+/******************************************************************************
+
+ Function workspace_end(): release a workspace allocated by workspace_init().
+
+******************************************************************************/
+
+inline static void workspace_end(johnson_workspace *work, johnson_workspace *w)
+{
+	if (work == NULL) johnson_workspace_free(w);
+}
+
 /******************************************************************************
 
  Function johnson_riccati_bessel(): returns the Riccati-Bessel function J(l, x)
@@ -68,225 +184,1115 @@ double johnson_riccati_bessel(const char type, const int l,
 
 /******************************************************************************
 
- Function johnson_modif_spher_bessel(): returns the modified spherical Bessel
- functions J(l, x) if type = 'j', or N(l, x) if type = 'n', as defined in Eq.
- (16) and (17) of Ref. [2]. These are made upon regular and irregular modified
- spherical Bessel functions, i(l, x) and k(l, x).
+ Function johnson_modif_spher_bessel(): returns the modified spherical Bessel
+ functions J(l, x) if type = 'j', or N(l, x) if type = 'n', as defined in Eq.
+ (16) and (17) of Ref. [2]. These are made upon regular and irregular modified
+ spherical Bessel functions, i(l, x) and k(l, x).
+
+******************************************************************************/
+
+double johnson_modif_spher_bessel(const char type, const int l,
+                                  const double wavenum, const double x)
+{
+	switch (type)
+	{
+		case 'j': return sqrt(wavenum*x)*gsl_sf_bessel_il_scaled(l, wavenum*x);
+		case 'n': return sqrt(wavenum*x)*gsl_sf_bessel_kl_scaled(l, wavenum*x);
+
+		default: return 0.0;
+	}
+}
+
+/******************************************************************************
+
+ Function asymptotic_pair(): the same as johnson_riccati_bessel(), for open
+ channels, or johnson_modif_spher_bessel(), for closed ones, but returning both
+ the function and its derivative with respect to x. Where, type = 'j' (regular
+ or growing solution) or 'n' (irregular or decaying solution).
+
+ NOTE: closed channels use the exponentially scaled functions, exp(-wavenum*x)
+ i(l, x) and exp(wavenum*x) k(l, x), and their derivatives are scaled alike.
+ Such a constant scaling of a closed channel solution does not change the open
+ block of the K matrix.
+
+******************************************************************************/
+
+inline static void asymptotic_pair(const char type,
+                                   const bool is_open,
+                                   const int l,
+                                   const double wavenum,
+                                   const double x,
+                                   double *f,
+                                   double *f_prime)
+{
+	const double z = wavenum*x;
+
+	if (is_open)
+	{
+/*
+ *		NOTE: from [z j(l, z)]' = (l + 1) j(l, z) - z j(l + 1, z), and likewise
+ *		for y(l, z).
+ */
+		const double sign = (type == 'j'? 1.0 : -1.0);
+
+		const double f_l = (type == 'j'? gsl_sf_bessel_jl(l, z) : gsl_sf_bessel_yl(l, z));
+		const double f_p = (type == 'j'? gsl_sf_bessel_jl(l + 1, z) : gsl_sf_bessel_yl(l + 1, z));
+
+		*f = sign*z*f_l/sqrt(wavenum);
+		*f_prime = sign*sqrt(wavenum)*(as_double(l + 1)*f_l - z*f_p);
+	}
+	else
+	{
+/*
+ *		NOTE: from [z i(l, z)]' = (l + 1) i(l, z) + z i(l + 1, z) and [z k(l, z)]'
+ *		= (l + 1) k(l, z) - z k(l + 1, z).
+ */
+		const double sign = (type == 'j'? 1.0 : -1.0);
+
+		const double f_l = (type == 'j'? gsl_sf_bessel_il_scaled(l, z) : gsl_sf_bessel_kl_scaled(l, z));
+		const double f_p = (type == 'j'? gsl_sf_bessel_il_scaled(l + 1, z) : gsl_sf_bessel_kl_scaled(l + 1, z));
+
+		*f = z*f_l;
+		*f_prime = wavenum*(as_double(l + 1)*f_l + sign*z*f_p);
+	}
+}
+
+/******************************************************************************
+
+ Function johnson_jcp77_workspace_alloc(): allocate the T, F and ratio arrays
+ used by johnson_jcp77_numerov() and johnson_jcp77_eigen() for grid_size points.
+ Passing it to each trial energy avoids any heap allocation inside the search.
+
+******************************************************************************/
+
+johnson_jcp77_workspace *johnson_jcp77_workspace_alloc(const size_t grid_size)
+{
+	ASSERT(grid_size > 2)
+
+	johnson_jcp77_workspace *work
+		= allocate(1, sizeof(johnson_jcp77_workspace), true);
+
+	work->grid_size = grid_size;
+
+	work->T = allocate(grid_size, sizeof(double), false);
+	work->F = allocate(grid_size, sizeof(double), false);
+
+	work->inward_R  = allocate(grid_size, sizeof(double), false);
+	work->outward_R = allocate(grid_size, sizeof(double), false);
+
+	return work;
+}
+
+/******************************************************************************
+
+ Function johnson_jcp77_workspace_free(): release resources allocated by
+ johnson_jcp77_workspace_alloc().
+
+******************************************************************************/
+
+void johnson_jcp77_workspace_free(johnson_jcp77_workspace *work)
+{
+	free(work->T);
+	free(work->F);
+	free(work->inward_R);
+	free(work->outward_R);
+
+	free(work);
+}
+
+/******************************************************************************
+
+ Function jcp77_match(): solves the inward and outward ratios of Ref. [3] at a
+ given trial energy and returns the matching point, M, where the difference, D
+ (named as error here), between both integrations and the number of nodes in
+ the outward solution are evaluated. On exit, M = 0 implies that no matching
+ point has been found, i.e. the trial energy is below the lowest eigenvalue.
+
+******************************************************************************/
+
+static size_t jcp77_match(const size_t grid_size,
+                          const double grid_step,
+                          const double pot_energy[],
+                          const double trial_energy,
+                          const double mass,
+                          double *error,
+                          size_t *nodes,
+                          johnson_jcp77_workspace *work)
+{
+	double *T = work->T;
+	double *inward_R = work->inward_R, *outward_R = work->outward_R;
+
+	const double factor = -grid_step*grid_step*2.0*mass/12.0;
+
+/*
+ *	Solve Eq. (32), (35) and (46) for each T, U and R (inward) coefficient:
+ */
+
+	inward_R[grid_size - 1] = 1.0E20;
+
+	T[grid_size - 1] = factor*(trial_energy - pot_energy[grid_size - 1]);
+
+	size_t M = 0;
+	for (size_t n = (grid_size - 2); n > 0; --n)
+	{
+		T[n] = factor*(trial_energy - pot_energy[n]);
+
+		inward_R[n] = (2.0 + 10.0*T[n])/(1.0 - T[n]) - 1.0/inward_R[n + 1];
+
+/*
+ *		Check if the matching point, M, is found:
+ */
+
+		if (inward_R[n] <= 1.0)
+		{
+			M = n;
+			break;
+		}
+	}
+
+	*nodes = 0;
+
+	if (M == 0)
+	{
+		*error = 1.0E20;
+		return 0;
+	}
+
+/*
+ *	Solve Eq. (32), (35) and (37) for each T, U and R (outward) coefficient,
+ *	up to the matching point inclusive, as needed by Eq. (48):
+ */
+
+	outward_R[0] = 1.0E20;
+
+	T[0] = factor*(trial_energy - pot_energy[0]);
+
+	for (size_t n = 1; n <= M; ++n)
+	{
+		if (n < M) T[n] = factor*(trial_energy - pot_energy[n]);
+
+		outward_R[n] = (2.0 + 10.0*T[n])/(1.0 - T[n]) - 1.0/outward_R[n - 1];
+
+/*
+ *		Count the number of nodes in the wavefunction:
+ */
+
+		if (n < M && outward_R[n] < 0.0) *nodes += 1;
+	}
+
+/*
+ *	Solve Eq. (48) for the difference, D, between the left and right
+ *	integrations:
+ */
+
+	*error = (0.5 - T[M + 1])*(1.0/inward_R[M + 1] - outward_R[M])/(1.0 - T[M + 1])
+	       - (0.5 - T[M - 1])*(inward_R[M] - 1.0/outward_R[M - 1])/(1.0 - T[M - 1]);
+
+	*error *= (1.0 - T[M]);
+
+	return M;
+}
+
+/******************************************************************************
+
+ Function jcp77_wavef(): solves Eq. (33), (36) and (45) for the unnormalized
+ wavefunction at grid_size points, from the ratios of the last jcp77_match()
+ call, with matching point M.
+
+******************************************************************************/
+
+static void jcp77_wavef(const size_t grid_size,
+                        const size_t M,
+                        johnson_jcp77_workspace *work,
+                        double wavef[])
+{
+	double *T = work->T, *F = work->F;
+	double *inward_R = work->inward_R, *outward_R = work->outward_R;
+
+	F[M] = 1.0;
+
+	for (size_t n = (M - 1); n < M; --n)
+		F[n] = F[n + 1]/outward_R[n];
+
+	for (size_t n = (M + 1); n < grid_size; ++n)
+		F[n] = F[n - 1]/inward_R[n];
+
+	for (size_t n = 0; n < grid_size; ++n)
+		wavef[n] = F[n]/(1.0 - T[n]);
+}
+
+/******************************************************************************
+
+ Function johnson_jcp77_numerov(): use the method of B. R. Johnson, Ref. [3],
+ to construct the single channel wavefunction at a given trial energy. The
+ return pointer contains the unormalized amplitude at grid_size points.
+
+ NOTE: on exit, a null pointer (and no nodes) implies that no matching point
+ has been found (see Ref. [3]). If work = NULL, a workspace is allocated (and
+ released) at each call.
+
+******************************************************************************/
+
+double *johnson_jcp77_numerov(const size_t grid_size,
+                              const double grid_step,
+                              const double pot_energy[],
+                              const double trial_energy,
+                              const double mass,
+                              double *error,
+                              size_t *nodes,
+                              johnson_jcp77_workspace *work)
+{
+	ASSERT(pot_energy != NULL)
+
+	johnson_jcp77_workspace *w
+		= (work == NULL? johnson_jcp77_workspace_alloc(grid_size) : work);
+
+	ASSERT(w->grid_size == grid_size)
+
+	const size_t M = jcp77_match(grid_size, grid_step,
+	                             pot_energy, trial_energy, mass, error, nodes, w);
+
+	double *wavef = NULL;
+
+	if (M > 0)
+	{
+		wavef = allocate(grid_size, sizeof(double), false);
+		jcp77_wavef(grid_size, M, w, wavef);
+	}
+
+	if (work == NULL) johnson_jcp77_workspace_free(w);
+
+	return wavef;
+}
+
+/******************************************************************************
+
+ Function jcp77_count(): returns the number of eigenvalues below trial_energy,
+ which is the number of nodes of the outward solution plus one if the matching
+ error, D, is positive (see Ref. [3]). The error is also returned.
+
+******************************************************************************/
+
+static size_t jcp77_count(const size_t grid_size,
+                          const double grid_step,
+                          const double pot_energy[],
+                          const double trial_energy,
+                          const double mass,
+                          double *error,
+                          johnson_jcp77_workspace *work)
+{
+	size_t nodes = 0;
+
+	const size_t M = jcp77_match(grid_size, grid_step,
+	                             pot_energy, trial_energy, mass, error, &nodes, work);
+
+	if (M == 0) return 0;
+
+	return (*error > 0.0? nodes + 1 : nodes);
+}
+
+/******************************************************************************
+
+ Function johnson_jcp77_eigen(): a Cooley-like search for the v-th eigenvalue
+ (v = 0 is the ground state) of the single channel problem of Ref. [3], which
+ is returned. First, [E_min, E_max] is bisected by the node count until only
+ the v-th eigenvalue is bracketed, E_max being raised as needed. Then, secant
+ steps on the matching error D(E) refine it, while the node count keeps the
+ bracket, and a bisection is taken whenever a secant step leaves it. The search
+ stops once the bracket or the step is smaller than tol. If wavef is not null,
+ the unnormalized wavefunction of the eigenvalue found is stored in it.
+
+ NOTE: the same workspace is used by every trial energy, thus no allocation
+ is done by the search. Still, each thread must have its own workspace.
+
+******************************************************************************/
+
+double johnson_jcp77_eigen(const size_t grid_size,
+                           const double grid_step,
+                           const double pot_energy[],
+                           const double mass,
+                           const size_t v,
+                           const double E_min,
+                           const double E_max,
+                           const double tol,
+                           double wavef[],
+                           johnson_jcp77_workspace *work)
+{
+	ASSERT(pot_energy != NULL)
+	ASSERT(work != NULL)
+	ASSERT(work->grid_size == grid_size)
+	ASSERT(E_max > E_min)
+
+	double error = 0.0;
+
+/*
+ *	Bracket: count(E_lo) <= v < count(E_hi), the upper bound being raised if
+ *	needed:
+ */
+
+	double E_lo = E_min, E_hi = E_max;
+
+	size_t count = jcp77_count(grid_size, grid_step, pot_energy, E_hi, mass, &error, work);
+
+	while (count <= v)
+	{
+		const double width = E_hi - E_lo;
+
+		E_lo = E_hi;
+		E_hi = E_hi + 2.0*width;
+
+		count = jcp77_count(grid_size, grid_step, pot_energy, E_hi, mass, &error, work);
+	}
+
+	double D_hi = error, D_lo = 0.0;
+	bool has_lo = false;
+
+	size_t count_hi = count;
+
+	count = jcp77_count(grid_size, grid_step, pot_energy, E_lo, mass, &error, work);
+
+	if (count == v)
+	{
+		D_lo = error;
+		has_lo = true;
+	}
+
+/*
+ *	Bisection by the node count until the v-th eigenvalue is the only one in
+ *	[E_lo, E_hi]:
+ */
+
+	while (!has_lo || count_hi > v + 1)
+	{
+		const double E = 0.5*(E_lo + E_hi);
+
+		count = jcp77_count(grid_size, grid_step, pot_energy, E, mass, &error, work);
+
+		if (count <= v)
+		{
+			E_lo = E;
+			D_lo = error;
+			has_lo = (count == v);
+		}
+		else
+		{
+			E_hi = E;
+			D_hi = error;
+			count_hi = count;
+		}
+
+		if (E_hi - E_lo < tol) break;
+	}
+
+/*
+ *	Secant steps on D(E), safeguarded by the bracket:
+ */
+
+	double E_a = E_lo, D_a = D_lo, E_b = E_hi, D_b = D_hi, E = 0.5*(E_lo + E_hi);
+
+	for (size_t iter = 0; iter < 200 && E_hi - E_lo > tol; ++iter)
+	{
+		E = (D_b != D_a? E_b - D_b*(E_b - E_a)/(D_b - D_a) : 0.5*(E_lo + E_hi));
+
+		if (E <= E_lo || E >= E_hi) E = 0.5*(E_lo + E_hi);
+
+		count = jcp77_count(grid_size, grid_step, pot_energy, E, mass, &error, work);
+
+		if (count <= v)
+			E_lo = E;
+		else
+			E_hi = E;
+
+		const double step = fabs(E - E_b);
+
+		E_a = E_b;
+		D_a = D_b;
+		E_b = E;
+		D_b = error;
+
+		if (step < tol) break;
+	}
+
+	if (wavef != NULL)
+	{
+		size_t nodes = 0;
+
+		const size_t M = jcp77_match(grid_size, grid_step,
+		                             pot_energy, E, mass, &error, &nodes, work);
+
+		ASSERT(M > 0)
+
+		jcp77_wavef(grid_size, M, work, wavef);
+	}
+
+	return E;
+}
+
+/******************************************************************************
+
+ Function johnson_jcp78_numerov(): uses the method of B. R. Johnson, Ref. [1],
+ to propagate the ratio matrix of a multichannel wavefunction from the radial
+ grid point (n - 1) to n at a given total energy.
+
+ NOTE: if work = NULL, a workspace is allocated (and released) at each call.
+ Both W^-1 and the inverse of the previous ratio enter Eq. (24) as full matrices
+ (there is no right-hand side to solve for), thus explicit inversions are kept.
+
+******************************************************************************/
+
+void johnson_jcp78_numerov(const double grid_step,
+                           const double mass, const double tot_energy,
+                           const matrix *pot_energy, matrix *ratio, johnson_workspace *work)
+{
+	ASSERT(ratio != NULL)
+	ASSERT(pot_energy != NULL)
+
+	johnson_workspace *ws = workspace_init(work, matrix_rows(ratio));
+
+	if (!matrix_is_null(ratio)) matrix_inverse_pivot(ratio, ws->pivot);
+
+/*
+ *	NOTE: From Eq. (2) and (17) of Ref. [1] the following numerical
+ *	factor is defined in atomic units:
+ */
+
+	const double factor = -grid_step*grid_step*2.0*mass/12.0;
+
+/*
+ *	Resolve Eq. (23) of Ref. [1] with Eq. (2) and (17) plugged in:
+ */
+
+	matrix *w = ws->a;
+
+	const int n_max = matrix_rows(pot_energy);
+
+	for (int n = 0; n < n_max; ++n)
+	{
+		const double t_nn = factor*(tot_energy - matrix_get(pot_energy, n, n));
+
+		matrix_set_diag(w, n, 1.0 - t_nn);
+
+		for (int m = (n + 1); m < n_max; ++m)
+		{
+			const double t_nm = factor*(0.0 - matrix_get(pot_energy, n, m));
+
+			matrix_set_symm(w, n, m, 0.0 - t_nm);
+		}
+	}
+
+/*
+ *	Solve Eq. (22) and (24) of Ref. [1]:
+ */
+
+	matrix_inverse_pivot(w, ws->pivot);
+
+	for (int n = 0; n < n_max; ++n)
+	{
+		const double u_nn = 12.0*matrix_get(w, n, n) - 10.0;
+
+		matrix_set_diag(ratio, n, u_nn - matrix_get(ratio, n, n));
+
+		for (int m = (n + 1); m < n_max; ++m)
+		{
+			const double u_nm = 12.0*matrix_get(w, n, m);
+
+			matrix_set_symm(ratio, n, m, u_nm - matrix_get(ratio, n, m));
+		}
+	}
+
+	w = NULL;
+
+	workspace_end(work, ws);
+}
+
+/******************************************************************************
+
+ Function johnson_jcp78_eigen(): return the eigenvalues of the potential matrix
+ at a given grid point, V = U diag(eigenval) U^T, whose eigenvectors are stored
+ as the columns of eigenvec. Since W = I - T of Eq. (23) of Ref. [1] depends on
+ the total energy only by a diagonal shift, this decomposition serves all the
+ energies propagated by johnson_jcp78_spectral() at the same grid point.
+
+******************************************************************************/
+
+double *johnson_jcp78_eigen(const matrix *pot_energy, matrix *eigenvec)
+{
+	ASSERT(eigenvec != NULL)
+	ASSERT(pot_energy != NULL)
+
+	matrix_copy(eigenvec, pot_energy, 1.0, 0.0);
+
+	double *eigenval = matrix_symm_eigen(eigenvec, 'v');
+
+	/* NOTE: MAGMA returns eigenvectors as rows. */
+	if (matrix_using_magma())
+	{
+		const size_t n_max = matrix_rows(eigenvec);
+
+		for (size_t n = 0; n < n_max; ++n)
+		{
+			for (size_t m = (n + 1); m < n_max; ++m)
+			{
+				const double x = matrix_get(eigenvec, n, m);
+
+				matrix_set(eigenvec, n, m, matrix_get(eigenvec, m, n));
+				matrix_set(eigenvec, m, n, x);
+			}
+		}
+	}
+
+	return eigenval;
+}
+
+/******************************************************************************
+
+ Function johnson_jcp78_spectral(): the same as johnson_jcp78_numerov() but the
+ inverse of W = I - T, Eq. (22) of Ref. [1], is built from the eigenpairs of the
+ potential matrix computed by johnson_jcp78_eigen(), as
+
+ W^-1 = U diag[1/(1 - f(E - eigenval))] U^T,
+
+ where f is the factor of Eq. (2) and (17). Thus, a matrix product replaces one
+ of the two inversions per energy and step. The workspace must be provided.
+
+ NOTE: the inversion of the ratio matrix of the previous grid point, Eq. (24),
+ depends on the energy and cannot be shared.
+
+******************************************************************************/
+
+void johnson_jcp78_spectral(const double grid_step,
+                            const double mass,
+                            const double tot_energy,
+                            const double eigenval[],
+                            const matrix *eigenvec,
+                            matrix *ratio,
+                            johnson_workspace *work)
+{
+	ASSERT(work != NULL)
+	ASSERT(ratio != NULL)
+	ASSERT(eigenval != NULL)
+	ASSERT(eigenvec != NULL)
+
+	matrix *workspace = work->a;
+
+	if (!matrix_is_null(ratio)) matrix_inverse_pivot(ratio, work->pivot);
+
+	const double factor = -grid_step*grid_step*2.0*mass/12.0;
+
+	const size_t n_max = matrix_rows(eigenvec);
+
+/*
+ *	Workspace = 12 U diag[1/(1 - f(E - eigenval))]:
+ */
+
+	for (size_t m = 0; m < n_max; ++m)
+	{
+		const double d = 12.0/(1.0 - factor*(tot_energy - eigenval[m]));
+
+		for (size_t n = 0; n < n_max; ++n)
+			matrix_set(workspace, n, m, d*matrix_get(eigenvec, n, m));
+	}
+
+/*
+ *	Solve Eq. (22) and (24) of Ref. [1], ratio = 12 W^-1 - 10 I - ratio^-1:
+ */
+
+	matrix_multiply_trans(1.0, 'n', workspace, 't', eigenvec, -1.0, ratio);
+
+	for (size_t n = 0; n < n_max; ++n)
+		matrix_decr(ratio, n, n, 10.0);
+}
+
+/******************************************************************************
+
+ Function spectral_step(): returns true if max_energy energies of max_ch channels
+ are cheaper to propagate by johnson_jcp78_spectral() than by johnson_jcp78_
+ numerov(). The former saves only a fraction of the cost per energy (10-40%),
+ which must pay for a dense diagonalization (about 10 steps of the latter). With
+ OpenBLAS on one core, the break-even is at about 12, 30, 70 and 120 energies
+ for 50, 100, 200 and 400 channels. Thus, at least JOHNSON_SPECTRAL_MIN_ENERGY
+ and max_ch/2 energies are required.
+
+******************************************************************************/
+
+inline static bool spectral_step(const size_t max_energy, const size_t max_ch)
+{
+	return (max_energy >= JOHNSON_SPECTRAL_MIN_ENERGY && 2*max_energy >= max_ch);
+}
+
+/******************************************************************************
+
+ Function johnson_jcp78_multi_numerov(): propagates the ratio matrices of many
+ total energies from the grid point (n - 1) to n. If there are enough energies,
+ see spectral_step(), the potential matrix is diagonalized only once for all of
+ them and johnson_jcp78_spectral() is used, otherwise johnson_jcp78_numerov().
+ Where, eigenvec is a matrix with the same size of pot_energy.
+
+ If use_omp is true, energies are propagated in parallel by OpenMP threads, in
+ which case work[] holds one workspace per thread, max_threads(), otherwise
+ only work[0] is used. The potential matrix and its eigenpairs are shared
+ read-only by all threads.
+
+ NOTE: BLAS/LAPACK calls made by each thread are expected to run sequentially,
+ which is the default of most threaded libraries inside parallel regions. With
+ MAGMA, energies are always propagated sequentially since the GPU queue is not
+ thread-safe.
+
+******************************************************************************/
+
+void johnson_jcp78_multi_numerov(const double grid_step,
+                                 const double mass,
+                                 const size_t max_energy,
+                                 const double tot_energy[],
+                                 const matrix *pot_energy,
+                                 matrix *ratio[],
+                                 matrix *eigenvec,
+                                 johnson_workspace *work[],
+                                 const bool use_omp)
+{
+	ASSERT(work != NULL)
+	ASSERT(ratio != NULL)
+	ASSERT(tot_energy != NULL)
+
+	const bool spectral = spectral_step(max_energy, matrix_rows(pot_energy));
+
+	double *eigenval = (spectral? johnson_jcp78_eigen(pot_energy, eigenvec) : NULL);
+
+	const bool use_threads = (use_omp && !matrix_using_magma());
+
+	#pragma omp parallel for default(none) shared(tot_energy, pot_energy, eigenval, eigenvec, ratio, work) firstprivate(grid_step, mass, max_energy, spectral, use_threads) schedule(dynamic) if(use_threads)
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		johnson_workspace *w = work[use_threads? thread_id() : 0];
+
+		if (spectral)
+			johnson_jcp78_spectral(grid_step, mass, tot_energy[m], eigenval, eigenvec, ratio[m], w);
+		else
+			johnson_jcp78_numerov(grid_step, mass, tot_energy[m], pot_energy, ratio[m], w);
+	}
+
+	if (eigenval != NULL) free(eigenval);
+}
+
+/******************************************************************************
+
+ Function lane_inverse(): b = a^-1 for JOHNSON_LANES matrices n-by-n at once, by
+ Gauss-Jordan elimination with partial pivoting, where a is destroyed. Elements
+ ij of all lanes are contiguous, i.e. a[(i*n + j)*JOHNSON_LANES + lane], thus
+ the innermost loops run over lanes and each lane may pivot on its own row.
+
+******************************************************************************/
+
+inline static void lane_inverse(const int n, double a[], double b[])
+{
+	const int L = JOHNSON_LANES;
+
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			for (int s = 0; s < L; ++s) b[(i*n + j)*L + s] = (i == j? 1.0 : 0.0);
+
+	for (int k = 0; k < n; ++k)
+	{
+		int pivot[JOHNSON_LANES];
+		double inv[JOHNSON_LANES];
+
+		#pragma omp simd
+		for (int s = 0; s < L; ++s)
+		{
+			pivot[s] = k;
+			double best = fabs(a[(k*n + k)*L + s]);
+
+			for (int p = (k + 1); p < n; ++p)
+			{
+				const double x = fabs(a[(p*n + k)*L + s]);
+
+				pivot[s] = (x > best? p : pivot[s]);
+				best = (x > best? x : best);
+			}
+		}
+
+/*
+ *		Swap rows k and pivot, lane by lane, as a blend over candidate rows:
+ */
+
+		for (int p = (k + 1); p < n; ++p)
+		{
+			for (int j = 0; j < n; ++j)
+			{
+				#pragma omp simd
+				for (int s = 0; s < L; ++s)
+				{
+					const bool swap = (pivot[s] == p);
+
+					const double a_kj = a[(k*n + j)*L + s], a_pj = a[(p*n + j)*L + s];
+					const double b_kj = b[(k*n + j)*L + s], b_pj = b[(p*n + j)*L + s];
+
+					a[(k*n + j)*L + s] = (swap? a_pj : a_kj);
+					a[(p*n + j)*L + s] = (swap? a_kj : a_pj);
+					b[(k*n + j)*L + s] = (swap? b_pj : b_kj);
+					b[(p*n + j)*L + s] = (swap? b_kj : b_pj);
+				}
+			}
+		}
+
+		#pragma omp simd
+		for (int s = 0; s < L; ++s)
+			inv[s] = 1.0/a[(k*n + k)*L + s];
+
+		for (int j = 0; j < n; ++j)
+		{
+			#pragma omp simd
+			for (int s = 0; s < L; ++s)
+			{
+				a[(k*n + j)*L + s] *= inv[s];
+				b[(k*n + j)*L + s] *= inv[s];
+			}
+		}
+
+		for (int p = 0; p < n; ++p)
+		{
+			if (p == k) continue;
+
+			double f[JOHNSON_LANES];
+
+			#pragma omp simd
+			for (int s = 0; s < L; ++s)
+				f[s] = a[(p*n + k)*L + s];
+
+			for (int j = 0; j < n; ++j)
+			{
+				#pragma omp simd
+				for (int s = 0; s < L; ++s)
+				{
+					a[(p*n + j)*L + s] -= f[s]*a[(k*n + j)*L + s];
+					b[(p*n + j)*L + s] -= f[s]*b[(k*n + j)*L + s];
+				}
+			}
+		}
+	}
+}
+
+/******************************************************************************
+
+ Function lane_step(): the same as johnson_jcp78_numerov(), but for n channels
+ and JOHNSON_LANES ratio matrices r at once, with the layout of lane_inverse(),
+ where v is the potential matrix shared by all lanes (n-by-n), energy the total
+ energy of each lane and centr the centrifugal term of each channel and lane,
+ centr[i*JOHNSON_LANES + lane]. Lanes whose start[lane] is true take r as null,
+ i.e. begin the propagation at this step. Both a, b and c are workspaces of the
+ size of r.
+
+******************************************************************************/
+
+inline static void lane_step(const int n,
+                             const double factor,
+                             const double v[],
+                             const double energy[],
+                             const double centr[],
+                             const bool start[],
+                             double r[],
+                             double a[],
+                             double b[],
+                             double c[])
+{
+	const int L = JOHNSON_LANES;
+
+	bool all_start = true;
+
+	for (int s = 0; s < L; ++s)
+		all_start = (all_start && start[s]);
+
+	if (all_start)
+	{
+		for (int i = 0; i < n*n*L; ++i) b[i] = 0.0;
+	}
+	else
+	{
+		for (int i = 0; i < n*n*L; ++i) a[i] = r[i];
+
+		lane_inverse(n, a, b);
+
+/*
+ *		NOTE: lanes just starting may hold anything in r (even a singular one).
+ */
+
+		for (int i = 0; i < n*n; ++i)
+		{
+			#pragma omp simd
+			for (int s = 0; s < L; ++s)
+				b[i*L + s] = (start[s]? 0.0 : b[i*L + s]);
+		}
+	}
+
+/*
+ *	Resolve Eq. (23) of Ref. [1] with Eq. (2) and (17) plugged in:
+ */
+
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			#pragma omp simd
+			for (int s = 0; s < L; ++s)
+			{
+				a[(i*n + j)*L + s] = (i == j? 1.0 - factor*(energy[s] - v[i*n + i] - centr[i*L + s])
+				                            : factor*v[i*n + j]);
+			}
+		}
+	}
+
+/*
+ *	Solve Eq. (22) and (24) of Ref. [1]:
+ */
+
+	lane_inverse(n, a, c);
+
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			#pragma omp simd
+			for (int s = 0; s < L; ++s)
+				r[(i*n + j)*L + s] = 12.0*c[(i*n + j)*L + s] - (i == j? 10.0 : 0.0) - b[(i*n + j)*L + s];
+		}
+	}
+}
+
+/******************************************************************************
+
+ Macro LANE_KERNEL(): instantiates lane_step() for a fixed number of channels n,
+ so that all loops but the ones over lanes have bounds known at compile time and
+ can be unrolled.
 
 ******************************************************************************/
 
-double johnson_modif_spher_bessel(const char type, const int l,
-                                  const double wavenum, const double x)
-{
-	switch (type)
-	{
-		case 'j': return sqrt(wavenum*x)*gsl_sf_bessel_il_scaled(l, wavenum*x);
-		case 'n': return sqrt(wavenum*x)*gsl_sf_bessel_kl_scaled(l, wavenum*x);
-
-		default: return 0.0;
-	}
+#define LANE_KERNEL(n)                                                         \
+static void lane_step_##n(const double factor,                                 \
+                          const double v[],                                    \
+                          const double energy[],                               \
+                          const double centr[],                                \
+                          const bool start[],                                  \
+                          double r[], double a[], double b[], double c[])      \
+{                                                                              \
+	lane_step(n, factor, v, energy, centr, start, r, a, b, c);                 \
 }
 
+LANE_KERNEL(1)
+LANE_KERNEL(2)
+LANE_KERNEL(3)
+LANE_KERNEL(4)
+LANE_KERNEL(5)
+LANE_KERNEL(6)
+LANE_KERNEL(7)
+LANE_KERNEL(8)
+
 /******************************************************************************
 
- Function johnson_jcp77_numerov(): use the method of B. R. Johnson, Ref. [3],
- to construct the single channel wavefunction at a given trial energy. The
- return pointer contains the unormalized amplitude at grid_size points.
+ Function johnson_jcp78_lane_numerov(): propagates, by the method of Ref. [1],
+ the ratio matrices of max_lane independent problems (lanes) of up to JOHNSON_
+ MAX_LANE_CH channels, which share the potential matrix, from grid point 0 to
+ grid_size - 1 of a uniform grid starting at R_min. Each lane has its own total
+ energy, tot_energy[lane], and angular momentum of each channel n, l[lane*max_
+ ch + n], e.g. different partial waves or energies of a few-channel problem.
+ Where pot_energy(R, v, params) must fill v with the potential matrix at R (no
+ centrifugal term), and ratio[] must be null on entry.
+
+ If start != NULL, lane m begins at grid point start[m], e.g. as given by johnson
+ _wkb_start(), rather than 0. A block is skipped until its first lane begins, so
+ lanes sorted by start (e.g. increasing l) save the most.
 
- NOTE: on exit, a negative number of nodes implies that no matching point has
- been found (see Ref. [3]).
+ Lanes are propagated in blocks of JOHNSON_LANES, with the layout of lane_step(),
+ whose kernel is picked by the number of channels. The ratio matrices of all
+ lanes at the last grid point are then ready for johnson_kmatrix().
+
+ NOTE: no matrix object or heap allocation is used inside the grid loop.
 
 ******************************************************************************/
 
-double *johnson_jcp77_numerov(const size_t grid_size,
-                              const double grid_step,
-                              const double pot_energy[],
-                              const double trial_energy,
-                              const double mass, double *error, size_t *nodes)
+void johnson_jcp78_lane_numerov(const size_t grid_size,
+                                const double grid_step,
+                                const double R_min,
+                                const double mass,
+                                const size_t max_lane,
+                                const double tot_energy[],
+                                const int l[],
+                                const size_t start[],
+                                void *params,
+                                void (*pot_energy)(const double R, matrix *v, void *params),
+                                matrix *ratio[])
 {
+	ASSERT(l != NULL)
+	ASSERT(ratio != NULL)
+	ASSERT(max_lane > 0)
+	ASSERT(tot_energy != NULL)
 	ASSERT(pot_energy != NULL)
 
-	double *T = allocate(grid_size, sizeof(double), false);
-	double *F = allocate(grid_size, sizeof(double), false);
+	const int max_ch = (int) matrix_rows(ratio[0]);
 
-	double *inward_R  = allocate(grid_size, sizeof(double), false);
-	double *outward_R = allocate(grid_size, sizeof(double), false);
+	ASSERT(max_ch <= JOHNSON_MAX_LANE_CH)
 
-/*
- *	Solve Eq. (32), (35) and (46) for each T, U and R (inward) coefficient:
- */
+	void (*kernel)(const double, const double [], const double [], const double [],
+	               const bool [], double [], double [], double [], double []) = NULL;
 
-	inward_R[grid_size - 1] = 1.0E20;
+	switch (max_ch)
+	{
+		case 1: kernel = lane_step_1; break;
+		case 2: kernel = lane_step_2; break;
+		case 3: kernel = lane_step_3; break;
+		case 4: kernel = lane_step_4; break;
+		case 5: kernel = lane_step_5; break;
+		case 6: kernel = lane_step_6; break;
+		case 7: kernel = lane_step_7; break;
+		case 8: kernel = lane_step_8; break;
+	}
 
-	T[grid_size - 1] =
-		-pow(grid_step, 2)*2.0*mass*(trial_energy - pot_energy[grid_size - 1])/12.0;
+	const size_t L = JOHNSON_LANES;
 
-	size_t M = 0;
-	for (size_t n = (grid_size - 2); n < grid_size; --n)
-	{
-		T[n] = -pow(grid_step, 2)*2.0*mass*(trial_energy - pot_energy[n])/12.0;
+	const size_t max_block = (max_lane + L - 1)/L;
 
-		inward_R[n] = (2.0 + 10.0*T[n])/(1.0 - T[n]) - 1.0/inward_R[n + 1];
+	const size_t block_size = max_ch*max_ch*L;
 
 /*
- *		Check if the matching point, M, is found:
+ *	NOTE: lanes beyond max_lane in the last block repeat the last one.
  */
 
-		if (inward_R[n] <= -1.0)
-		{
-			M = n;
-			break;
-		}
-	}
+	double *energy = allocate(max_block*L, sizeof(double), false);
+	double *centr_l = allocate(max_block*max_ch*L, sizeof(double), false);
 
-	if (M == 0)
+	size_t *first = allocate(max_block*L, sizeof(size_t), false);
+	size_t *block_first = allocate(max_block, sizeof(size_t), false);
+
+	for (size_t b = 0; b < max_block; ++b)
 	{
-		free(T);
-		free(F);
-		free(inward_R);
-		free(outward_R);
+		for (size_t s = 0; s < L; ++s)
+		{
+			const size_t lane = (b*L + s < max_lane? b*L + s : max_lane - 1);
 
-		*error =  1.0E20;
-		*nodes = -1;
-		return NULL;
-	}
+			ASSERT(matrix_is_null(ratio[lane]))
 
-/*
- *	Solve Eq. (32), (35) and (37) for each T, U and R (outward) coefficient:
- */
+			energy[b*L + s] = tot_energy[lane];
 
-	outward_R[0] = 1.0E20;
+			first[b*L + s] = (start != NULL? start[lane] : 0);
 
-	T[0] = -pow(grid_step, 2)*2.0*mass*(trial_energy - pot_energy[0])/12.0;
+			if (s == 0 || first[b*L + s] < block_first[b]) block_first[b] = first[b*L + s];
 
-	*nodes = 0;
-	for (size_t n = 1; n < M; ++n)
-	{
-		T[n] = -pow(grid_step, 2)*2.0*mass*(trial_energy - pot_energy[n])/12.0;
+			for (int i = 0; i < max_ch; ++i)
+				centr_l[(b*max_ch + i)*L + s] = centr_term(l[lane*max_ch + i], mass, 1.0);
+		}
+	}
 
-		outward_R[n] = (2.0 + 10.0*T[n])/(1.0 - T[n]) - 1.0/outward_R[n - 1];
+	double *r = allocate(max_block*block_size, sizeof(double), true);
+	double *work = allocate(3*block_size + max_ch*L + max_ch*max_ch, sizeof(double), false);
 
-/*
- *		Count the number of nodes in the wavefunction:
- */
+	double *centr = work + 3*block_size;
+	double *v_data = centr + max_ch*L;
 
-		if (outward_R[n] < 0.0) *nodes += 1;
-	}
+	matrix *v = matrix_alloc(max_ch, max_ch, false);
 
-/*
- *	Solve Eq. (36) and (45) for each F coefficient:
- */
+	const double factor = -grid_step*grid_step*2.0*mass/12.0;
 
-	F[M] = 1.0;
+	for (size_t n = 0; n < grid_size; ++n)
+	{
+		const double R = R_min + as_double(n)*grid_step;
 
-	for (size_t n = (M - 1); n < M; --n)
-		F[n] = F[n + 1]/outward_R[n];
+		pot_energy(R, v, params);
 
-	for (size_t n = (M + 1); n < grid_size; ++n)
-		F[n] = F[n - 1]/inward_R[n];
+		for (int i = 0; i < max_ch; ++i)
+			for (int j = 0; j < max_ch; ++j)
+				v_data[i*max_ch + j] = matrix_get(v, i, j);
 
-/*
- *	Solve Eq. (33) for the wavefunction (unnormalized):
- */
+		for (size_t b = 0; b < max_block; ++b)
+		{
+			if (n < block_first[b]) continue;
 
-	double *wavef = allocate(grid_size, sizeof(double), false);
+			bool begin[JOHNSON_LANES];
 
-	for (size_t n = 0; n < grid_size; ++n)
-		wavef[n] = F[n]/(1.0 - T[n]);
+			for (size_t s = 0; s < L; ++s)
+				begin[s] = (n <= first[b*L + s]);
 
-/*
- *	Solve Eq. (48) for the difference, D (named as error here), between the
- *	left and right integrations:
- */
+			for (size_t i = 0; i < max_ch*L; ++i)
+				centr[i] = centr_l[b*max_ch*L + i]/(R*R);
 
-	*error = (0.5 - T[M + 1])*(1.0/inward_R[M + 1] - outward_R[M])/(1.0 - T[M + 1])
-	       - (0.5 - T[M - 1])*(inward_R[M] - 1.0/outward_R[M - 1])/(1.0 - T[M - 1]);
+			kernel(factor, v_data, energy + b*L, centr, begin, r + b*block_size,
+			       work, work + block_size, work + 2*block_size);
+		}
+	}
 
-	*error *= (1.0 - T[M]);
+	for (size_t lane = 0; lane < max_lane; ++lane)
+	{
+		const size_t b = lane/L, s = lane%L;
 
-	free(T);
-	free(F);
-	free(inward_R);
-	free(outward_R);
+		for (int i = 0; i < max_ch; ++i)
+			for (int j = 0; j < max_ch; ++j)
+				matrix_set(ratio[lane], i, j, r[b*block_size + (i*max_ch + j)*L + s]);
+	}
 
-	return wavef;
+	matrix_free(v);
+
+	free(energy);
+	free(centr_l);
+	free(block_first);
+	free(first);
+	free(work);
+	free(r);
 }
 
 /******************************************************************************
 
- Function johnson_jcp78_numerov(): uses the method of B. R. Johnson, Ref. [1],
- to propagate the ratio matrix of a multichannel wavefunction from the radial
- grid point (n - 1) to n at a given total energy.
+ Function johnson_wkb_start(): returns the index of a grid point deep enough in
+ the classically forbidden region of all channels that a wavefunction vanishing
+ there is exact to about exp(-depth). Where pot_energy[n*max_ch + c] is the
+ diagonal of the potential matrix (centrifugal term included) of channel c at
+ grid point n, for a total energy tot_energy. From the first grid point where
+ any channel is open, n_turn, the WKB phase integral of the least closed channel,
 
- NOTE: the potential matrix is used as workspace and its content is destroyed
- if workspace = NULL.
+ S(n) = grid_step sum_{k = n}^{n_turn - 1} min_c sqrt(2 mass [V_c(k) - E]),
+
+ is accumulated inward and the largest n with S(n) >= depth is returned, or 0
+ if there is none.
 
 ******************************************************************************/
 
-void johnson_jcp78_numerov(const double grid_step,
-                           const double mass, const double tot_energy,
-                           matrix *pot_energy, matrix *ratio, matrix *workspace)
+size_t johnson_wkb_start(const size_t grid_size,
+                         const size_t max_ch,
+                         const double grid_step,
+                         const double mass,
+                         const double tot_energy,
+                         const double depth,
+                         const double pot_energy[])
 {
-	ASSERT(ratio != NULL)
+	ASSERT(max_ch > 0)
 	ASSERT(pot_energy != NULL)
 
-	if (!matrix_is_null(ratio)) matrix_inverse(ratio);
-
-/*
- *	NOTE: From Eq. (2) and (17) of Ref. [1] the following numerical
- *	factor is defined in atomic units:
- */
-
-	const double factor = -grid_step*grid_step*2.0*mass/12.0;
-
-/*
- *	Resolve Eq. (23) of Ref. [1] with Eq. (2) and (17) plugged in:
- */
-
-	matrix *w = NULL;
-
-	if (workspace == NULL)
-		w = pot_energy;
-	else
-		w = workspace;
-
-	const int n_max = matrix_rows(pot_energy);
+	size_t n_turn = 0;
 
-	for (int n = 0; n < n_max; ++n)
+	while (n_turn < grid_size)
 	{
-		const double t_nn = factor*(tot_energy - matrix_get(pot_energy, n, n));
+		bool open = false;
 
-		matrix_set_diag(w, n, 1.0 - t_nn);
+		for (size_t c = 0; c < max_ch; ++c)
+			open = (open || pot_energy[n_turn*max_ch + c] <= tot_energy);
 
-		for (int m = (n + 1); m < n_max; ++m)
-		{
-			const double t_nm = factor*(0.0 - matrix_get(pot_energy, n, m));
+		if (open) break;
 
-			matrix_set_symm(w, n, m, 0.0 - t_nm);
-		}
+		++n_turn;
 	}
 
-/*
- *	Solve Eq. (22) and (24) of Ref. [1]:
- */
-
-	matrix_inverse(w);
+	double phase = 0.0;
 
-	for (int n = 0; n < n_max; ++n)
+	for (size_t n = (n_turn - 1); n < n_turn; --n)
 	{
-		const double u_nn = 12.0*matrix_get(w, n, n) - 10.0;
+		double kappa = INF;
 
-		matrix_set_diag(ratio, n, u_nn - matrix_get(ratio, n, n));
+		for (size_t c = 0; c < max_ch; ++c)
+			kappa = fmin(kappa, sqrt(2.0*mass*(pot_energy[n*max_ch + c] - tot_energy)));
 
-		for (int m = (n + 1); m < n_max; ++m)
-		{
-			const double u_nm = 12.0*matrix_get(w, n, m);
+		phase += grid_step*kappa;
 
-			matrix_set_symm(ratio, n, m, u_nm - matrix_get(ratio, n, m));
-		}
+		if (phase >= depth) return n;
 	}
 
-	w = NULL;
+	return 0;
 }
 
 /******************************************************************************
@@ -295,12 +1301,14 @@ void johnson_jcp78_numerov(const double grid_step,
  in order to propagate the multichannel log derivative matrix, Y, from the
  radial grid point (n - 1) to n driven by the interaction potential V.
 
- NOTE: matrix V is defined as Eq. (2) of Ref. [4].
+ NOTE: matrix V is defined as Eq. (2) of Ref. [4]. If work = NULL, a workspace
+ is allocated (and released) at each call.
 
 ******************************************************************************/
 
 void johnson_jcp73_logd(const int n, const int grid_size,
-                        const double grid_step, const matrix *pot_energy, matrix *y)
+                        const double grid_step, const matrix *pot_energy,
+                        matrix *y, johnson_workspace *work)
 {
 	ASSERT(n > 0)
 	ASSERT(y != NULL)
@@ -310,10 +1318,12 @@ void johnson_jcp73_logd(const int n, const int grid_size,
 
 	const int max_ch = matrix_rows(pot_energy);
 
-	/* NOTE: a = (I + hY)^-1 from the left term of Eq. (6). */
-	matrix *a = matrix_alloc(max_ch, max_ch, false);
+	johnson_workspace *ws = workspace_init(work, max_ch);
+
+	/* NOTE: a = (I + hY), whose inverse is the left term of Eq. (6). */
+	matrix *a = ws->a;
 
-	matrix *eq6_right_term = matrix_alloc(max_ch, max_ch, false);
+	matrix *eq6_right_term = ws->b;
 
 /*
  *	Solve Eq. (7) of Ref. [4]:
@@ -345,8 +1355,8 @@ void johnson_jcp73_logd(const int n, const int grid_size,
 		const double weight = (n == grid_size? 1.0 : 4.0);
 		const double factor = grid_step*grid_step/6.0;
 
-		/* NOTE: b = [I + (h^2/6)V]^-1 from the right term of Eq. (6). */
-		matrix *b = matrix_alloc(max_ch, max_ch, false);
+		/* NOTE: b = [I + (h^2/6)V], whose inverse is in the right term of Eq. (6). */
+		matrix *b = ws->c;
 
 		for (int p = 0; p < max_ch; ++p)
 		{
@@ -364,18 +1374,14 @@ void johnson_jcp73_logd(const int n, const int grid_size,
 			}
 		}
 
-		matrix_inverse(b);
-		matrix_multiply(grid_step*weight/3.0, b, pot_energy, 0.0, eq6_right_term);
-
-		matrix_free(b);
+		matrix_copy(eq6_right_term, pot_energy, grid_step*weight/3.0, 0.0);
+		matrix_symm_solve(b, eq6_right_term, ws->pivot);
 	}
 
-	matrix *eq6_left_term = matrix_alloc(max_ch, max_ch, false);
-
-	matrix_inverse(a);
-	matrix_multiply(1.0, a, y, 0.0, eq6_left_term);
+	matrix *eq6_left_term = ws->d;
 
-	matrix_free(a);
+	matrix_copy(eq6_left_term, y, 1.0, 0.0);
+	matrix_symm_solve(a, eq6_left_term, ws->pivot);
 
 /*
  *	Solve Eq. (6) of Ref. [4]:
@@ -383,8 +1389,7 @@ void johnson_jcp73_logd(const int n, const int grid_size,
 
 	matrix_sub(1.0, eq6_left_term, 1.0, eq6_right_term, y);
 
-	matrix_free(eq6_left_term);
-	matrix_free(eq6_right_term);
+	workspace_end(work, ws);
 }
 
 /******************************************************************************
@@ -395,7 +1400,8 @@ void johnson_jcp73_logd(const int n, const int grid_size,
  value of each channel, respectively, as R -> inf.
 
  NOTE: both l and level are vectors with the same size of the rows (or columns)
- of the ratio matrix, i.e. total number of channels.
+ of the ratio matrix, i.e. total number of channels. Only the K matrix returned
+ is allocated if a workspace is given.
 
 ******************************************************************************/
 
@@ -405,7 +1411,8 @@ matrix *johnson_kmatrix(const int l[],
                         const double mass,
                         const double level[],
                         const matrix *ratio,
-                        const double R)
+                        const double R,
+                        johnson_workspace *work)
 {
 	ASSERT(l != NULL)
 	ASSERT(ratio != NULL)
@@ -413,6 +1420,8 @@ matrix *johnson_kmatrix(const int l[],
 
 	const int max_ch = matrix_rows(ratio);
 
+	johnson_workspace *ws = workspace_init(work, max_ch);
+
 /*
  *	NOTE: from Eq. (2) and (17) of Ref. [1] the following numerical factor is
  *	defined in atomic units:
@@ -422,12 +1431,16 @@ matrix *johnson_kmatrix(const int l[],
 		= -grid_step*grid_step*2.0*mass/12.0;
 
 /*
- *	Step 1: build the j(R) and n(R) diagonal matrices defined by Eq. (A16) and
- *	(A17) of Ref. [1]; where, Eq. (23) is also used:
+ *	Step 1 and 2: build the product rn and rj (r := ratio) at the grid point R,
+ *	as shown in Eq. (A19) of Ref. [1]. Since j(R) and n(R), Eq. (A16) and (A17)
+ *	with Eq. (23), are diagonal, the products just scale the columns of r:
  */
 
-	matrix *n = matrix_alloc(max_ch, max_ch, true);
-	matrix *j = matrix_alloc(max_ch, max_ch, true);
+	matrix *rn = ws->a;
+	matrix *rj = ws->b;
+
+	matrix_copy(rn, ratio, 1.0, 0.0);
+	matrix_copy(rj, ratio, 1.0, 0.0);
 
 	for (int i = 0; i < max_ch; ++i)
 	{
@@ -439,51 +1452,35 @@ matrix *johnson_kmatrix(const int l[],
 			const double w
 				= 1.0 - factor*(tot_energy - centr_term(l[i], mass, R));
 
-			matrix_set(n, i, i, w*johnson_riccati_bessel('n', l[i], wavenum, R));
-			matrix_set(j, i, i, w*johnson_riccati_bessel('j', l[i], wavenum, R));
-		}
-		else
-		{
-			matrix_set(n, i, i, 1.0);
-			matrix_set(j, i, i, 1.0);
+			matrix_scale_col(rn, i, w*johnson_riccati_bessel('n', l[i], wavenum, R));
+			matrix_scale_col(rj, i, w*johnson_riccati_bessel('j', l[i], wavenum, R));
 		}
 	}
 
-/*
- *	Step 2: build the product rn and rj (r := ratio) at the grid point R, as
- *	shown in Eq. (A19) of Ref. [1]:
- */
-
-	matrix *rn = matrix_alloc(max_ch, max_ch, false);
-	matrix *rj = matrix_alloc(max_ch, max_ch, false);
-
-	matrix_multiply(1.0, ratio, n, 0.0, rn);
-	matrix_multiply(1.0, ratio, j, 0.0, rj);
-
-	matrix_free(j);
-	matrix_free(n);
-
 /*
  *	Step 3: subtract j(R + grid_step) and n(R + grid_step) diagonal matrices
- *	from the rn(R) and rj(R) products, following Eq. (A19) of Ref. [1]:
+ *	from the rn(R) and rj(R) products, following Eq. (A19) of Ref. [1]. For
+ *	closed channels, the ratios j(R + grid_step)/j(R) and n(R + grid_step)/n(R)
+ *	are used instead, where the factors exp(+wavenum*grid_step) and exp(-wavenum
+ *	*grid_step) undo the scaling of johnson_modif_spher_bessel():
  */
 
 	for (int i = 0; i < max_ch; ++i)
 	{
 		const double wavenum
-			= sqrt(2.0*mass*(tot_energy - level[i]));
+			= sqrt(2.0*mass*fabs(tot_energy - level[i]));
 
 		const double w_prime
 			= 1.0 - factor*(tot_energy - centr_term(l[i], mass, R + grid_step));
 
-		const double n_prime
-			= w_prime*johnson_riccati_bessel('n', l[i], wavenum, R + grid_step);
-
-		const double j_prime
-			= w_prime*johnson_riccati_bessel('j', l[i], wavenum, R + grid_step);
-
 		if (level[i] < tot_energy)
 		{
+			const double n_prime
+				= w_prime*johnson_riccati_bessel('n', l[i], wavenum, R + grid_step);
+
+			const double j_prime
+				= w_prime*johnson_riccati_bessel('j', l[i], wavenum, R + grid_step);
+
 			matrix_decr(rn, i, i, n_prime);
 			matrix_decr(rj, i, i, j_prime);
 		}
@@ -492,6 +1489,12 @@ matrix *johnson_kmatrix(const int l[],
 			const double w
 				= 1.0 - factor*(tot_energy - centr_term(l[i], mass, R));
 
+			const double n_prime = w_prime*exp(-wavenum*grid_step)
+			                     *johnson_modif_spher_bessel('n', l[i], wavenum, R + grid_step);
+
+			const double j_prime = w_prime*exp(wavenum*grid_step)
+			                     *johnson_modif_spher_bessel('j', l[i], wavenum, R + grid_step);
+
 			matrix_decr(rn, i, i, n_prime/(w*johnson_modif_spher_bessel('n', l[i], wavenum, R)));
 			matrix_decr(rj, i, i, j_prime/(w*johnson_modif_spher_bessel('j', l[i], wavenum, R)));
 		}
@@ -503,11 +1506,81 @@ matrix *johnson_kmatrix(const int l[],
 
 	matrix *k = matrix_alloc(max_ch, max_ch, false);
 
-	matrix_inverse(rn);
-	matrix_multiply(-1.0, rn, rj, 0.0, k);
+	matrix_solve(rn, rj, ws->pivot);
+	matrix_copy(k, rj, -1.0, 0.0);
+
+	workspace_end(work, ws);
+	return k;
+}
+
+/******************************************************************************
+
+ Function johnson_logd_kmatrix(): build the augmented reactant matrix K from the
+ log derivative matrix Y = F'F^-1 of the multichannel wavefunction at the grid
+ point R, by matching F = J + NK to the asymptotic solutions:
+
+ K = -(YN - N')^-1 (YJ - J'),
+
+ where J and N are diagonal matrices of Riccati-Bessel functions, for open
+ channels, or modified spherical Bessel functions, for closed ones, see
+ johnson_kmatrix(). The open-open block of K is the physical K matrix.
+
+ NOTE: l and level are as in johnson_kmatrix(). Only the K matrix returned is
+ allocated if a workspace is given.
+
+******************************************************************************/
+
+matrix *johnson_logd_kmatrix(const int l[],
+                             const double tot_energy,
+                             const double mass,
+                             const double level[],
+                             const matrix *y,
+                             const double R,
+                             johnson_workspace *work)
+{
+	ASSERT(l != NULL)
+	ASSERT(y != NULL)
+	ASSERT(level != NULL)
+
+	const int max_ch = matrix_rows(y);
+
+	johnson_workspace *ws = workspace_init(work, max_ch);
+
+/*
+ *	Since J and N are diagonal, the products YN and YJ just scale the columns
+ *	of Y:
+ */
+
+	matrix *yn = ws->a;
+	matrix *yj = ws->b;
+
+	matrix_copy(yn, y, 1.0, 0.0);
+	matrix_copy(yj, y, 1.0, 0.0);
+
+	for (int i = 0; i < max_ch; ++i)
+	{
+		const bool is_open = (level[i] < tot_energy);
+
+		const double wavenum = sqrt(2.0*mass*fabs(tot_energy - level[i]));
+
+		double j = 0.0, j_prime = 0.0, n = 0.0, n_prime = 0.0;
+
+		asymptotic_pair('j', is_open, l[i], wavenum, R, &j, &j_prime);
+		asymptotic_pair('n', is_open, l[i], wavenum, R, &n, &n_prime);
+
+		matrix_scale_col(yn, i, n);
+		matrix_scale_col(yj, i, j);
+
+		matrix_decr(yn, i, i, n_prime);
+		matrix_decr(yj, i, i, j_prime);
+	}
+
+	matrix *k = matrix_alloc(max_ch, max_ch, false);
+
+	matrix_solve(yn, yj, ws->pivot);
+	matrix_copy(k, yj, -1.0, 0.0);
 
-	matrix_free(rn);
-	matrix_free(rj);
+	workspace_end(work, ws);
 	return k;
 }
 
@@ -521,17 +1594,20 @@ matrix *johnson_kmatrix(const int l[],
 
  Where, I is the unit matrix and K is the open-open block of a reactant matrix.
 
- For details see Eq. (20) of Ref. [2].
+ For details see Eq. (20) of Ref. [2]. The workspace, if any, must have the size
+ of K.
 
 ******************************************************************************/
 
-smatrix *johnson_smatrix(const matrix *k)
+smatrix *johnson_smatrix(const matrix *k, johnson_workspace *work)
 {
 	const int max_ch = matrix_rows(k);
 
-	matrix *a = matrix_alloc(max_ch, max_ch, false);
-	matrix *b = matrix_alloc(max_ch, max_ch, false);
-	matrix *c = matrix_alloc(max_ch, max_ch, false);
+	johnson_workspace *ws = workspace_init(work, max_ch);
+
+	matrix *a = ws->a;
+	matrix *b = ws->b;
+	matrix *c = ws->c;
 
 /*
  *	Resolve A = KK, B = (I + A) and C = (I - A):
@@ -555,7 +1631,7 @@ smatrix *johnson_smatrix(const matrix *k)
  *	Build the S matrix, Re(S) = C*inv(B) and Im(S) = 2*K*inv(B):
  */
 
-	matrix_inverse(b);
+	matrix_inverse_pivot(b, ws->pivot);
 
 	smatrix *s = calloc(1, sizeof(smatrix));
 
@@ -565,8 +1641,161 @@ smatrix *johnson_smatrix(const matrix *k)
 	matrix_multiply(1.0, c, b, 0.0, s->re_part);
 	matrix_multiply(2.0, k, b, 0.0, s->im_part);
 
-	matrix_free(a);
-	matrix_free(b);
-	matrix_free(c);
+	workspace_end(work, ws);
+	return s;
+}
+
+/******************************************************************************
+
+ Function johnson_open_smatrix(): the same as johnson_smatrix(), but from the
+ augmented K matrix of all channels, whose open-open block is extracted first,
+ and by a single complex linear solve,
+
+ (I - iK) S = (I + iK),
+
+ since (I + iK) and (I - iK)^-1 commute. Where, level is as in johnson_kmatrix()
+ and the S matrix returned has the size of the number of open channels, or is
+ NULL if there are none.
+
+ NOTE: the pivots of the workspace, if any, are used. Thus, its size must be of
+ the augmented K.
+
+******************************************************************************/
+
+smatrix *johnson_open_smatrix(const matrix *k,
+                              const double level[],
+                              const double tot_energy,
+                              johnson_workspace *work)
+{
+	ASSERT(k != NULL)
+	ASSERT(level != NULL)
+
+	const size_t max_ch = matrix_rows(k);
+
+	size_t *open = allocate(max_ch, sizeof(size_t), false);
+
+	size_t max_open = 0;
+
+	for (size_t n = 0; n < max_ch; ++n)
+		if (level[n] < tot_energy) open[max_open++] = n;
+
+	if (max_open == 0)
+	{
+		free(open);
+		return NULL;
+	}
+
+	double complex *a = allocate(max_open*max_open, sizeof(double complex), false);
+	double complex *b = allocate(max_open*max_open, sizeof(double complex), false);
+
+	for (size_t n = 0; n < max_open; ++n)
+	{
+		for (size_t m = 0; m < max_open; ++m)
+		{
+			const double k_nm = matrix_get(k, open[n], open[m]);
+			const double delta = (n == m? 1.0 : 0.0);
+
+			a[n*max_open + m] = delta - I*k_nm;
+			b[n*max_open + m] = delta + I*k_nm;
+		}
+	}
+
+	matrix_complex_solve(max_open, max_open, a, b, (work != NULL? work->pivot : NULL));
+
+	smatrix *s = calloc(1, sizeof(smatrix));
+
+	s->re_part = matrix_alloc(max_open, max_open, false);
+	s->im_part = matrix_alloc(max_open, max_open, false);
+
+	for (size_t n = 0; n < max_open; ++n)
+	{
+		for (size_t m = 0; m < max_open; ++m)
+		{
+			matrix_set(s->re_part, n, m, creal(b[n*max_open + m]));
+			matrix_set(s->im_part, n, m, cimag(b[n*max_open + m]));
+		}
+	}
+
+	free(open);
+	free(a);
+	free(b);
+
 	return s;
 }
+
+/******************************************************************************
+
+ Function johnson_multi_kmatrix(): the same as johnson_multi_smatrix(), but for
+ the K matrices of all channels, k[m], from the ratio matrices of many total
+ energies propagated up to the same grid point R.
+
+******************************************************************************/
+
+void johnson_multi_kmatrix(const int l[],
+                           const double grid_step,
+                           const size_t max_energy,
+                           const double tot_energy[],
+                           const double mass,
+                           const double level[],
+                           matrix *ratio[],
+                           const double R,
+                           matrix *k[],
+                           johnson_workspace *work[],
+                           const bool use_omp)
+{
+	ASSERT(k != NULL)
+	ASSERT(work != NULL)
+	ASSERT(ratio != NULL)
+
+	const bool use_threads = (use_omp && !matrix_using_magma());
+
+	#pragma omp parallel for default(none) shared(l, tot_energy, level, ratio, k, work) firstprivate(grid_step, mass, max_energy, R, use_threads) schedule(dynamic) if(use_threads)
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		johnson_workspace *w = work[use_threads? thread_id() : 0];
+
+		k[m] = johnson_kmatrix(l, grid_step, tot_energy[m], mass, level, ratio[m], R, w);
+	}
+}
+
+/******************************************************************************
+
+ Function johnson_multi_smatrix(): computes the open-channel S matrices of many
+ total energies, from the ratio matrices propagated by johnson_jcp78_multi_
+ numerov() up to the grid point R[m] of each energy m. Each energy goes through
+ johnson_kmatrix() and johnson_open_smatrix(), in parallel by OpenMP threads if
+ use_omp is true, each one using work[thread_id()], as in johnson_jcp78_multi_
+ numerov().
+
+******************************************************************************/
+
+void johnson_multi_smatrix(const int l[],
+                           const double grid_step,
+                           const size_t max_energy,
+                           const double tot_energy[],
+                           const double mass,
+                           const double level[],
+                           matrix *ratio[],
+                           const double R[],
+                           smatrix *s[],
+                           johnson_workspace *work[],
+                           const bool use_omp)
+{
+	ASSERT(s != NULL)
+	ASSERT(work != NULL)
+	ASSERT(ratio != NULL)
+
+	const bool use_threads = (use_omp && !matrix_using_magma());
+
+	#pragma omp parallel for default(none) shared(l, tot_energy, level, ratio, R, s, work) firstprivate(grid_step, mass, max_energy, use_threads) schedule(dynamic) if(use_threads)
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		johnson_workspace *w = work[use_threads? thread_id() : 0];
+
+		matrix *k = johnson_kmatrix(l, grid_step, tot_energy[m], mass, level, ratio[m], R[m], w);
+
+		s[m] = johnson_open_smatrix(k, level, tot_energy[m], w);
+
+		matrix_free(k);
+	}
+}
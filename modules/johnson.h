@@ -3,6 +3,16 @@
 	#include "globals.h"
 	#include "matrix.h"
 
+	#if !defined(JOHNSON_LANES)
+		#define JOHNSON_LANES 8
+	#endif
+
+	#define JOHNSON_MAX_LANE_CH 8
+
+	#if !defined(JOHNSON_SPECTRAL_MIN_ENERGY)
+		#define JOHNSON_SPECTRAL_MIN_ENERGY 32
+	#endif
+
 	struct smatrix
 	{
 		matrix *re_part, *im_part;
@@ -10,6 +20,34 @@
 
 	typedef struct smatrix smatrix;
 
+	struct johnson_workspace
+	{
+		size_t max_ch;
+		matrix *a, *b, *c, *d;
+		matrix_pivot *pivot;
+		double *diag;
+	};
+
+	typedef struct johnson_workspace johnson_workspace;
+
+	struct johnson_jcp77_workspace
+	{
+		size_t grid_size;
+		double *T, *F, *inward_R, *outward_R;
+	};
+
+	typedef struct johnson_jcp77_workspace johnson_jcp77_workspace;
+
+	johnson_workspace *johnson_workspace_alloc(const size_t max_ch);
+
+	void johnson_workspace_free(johnson_workspace *work);
+
+	johnson_workspace **johnson_workspace_list(const size_t max_workspace,
+	                                           const size_t max_ch);
+
+	void johnson_workspace_list_free(const size_t max_workspace,
+	                                 johnson_workspace *work[]);
+
 	double johnson_riccati_bessel(const char type,
 	                              const int l,
 	                              const double wavenum,
@@ -20,23 +58,80 @@
 	                                  const double wavenum,
 	                                  const double x);
 
+	johnson_jcp77_workspace *johnson_jcp77_workspace_alloc(const size_t grid_size);
+
+	void johnson_jcp77_workspace_free(johnson_jcp77_workspace *work);
+
 	double *johnson_jcp77_numerov(const size_t grid_size,
 	                              const double grid_step,
 	                              const double pot_energy[],
 	                              const double trial_energy,
 	                              const double mass,
 	                              double *error,
-	                              size_t *nodes);
+	                              size_t *nodes,
+	                              johnson_jcp77_workspace *work);
+
+	double johnson_jcp77_eigen(const size_t grid_size,
+	                           const double grid_step,
+	                           const double pot_energy[],
+	                           const double mass,
+	                           const size_t v,
+	                           const double E_min,
+	                           const double E_max,
+	                           const double tol,
+	                           double wavef[],
+	                           johnson_jcp77_workspace *work);
 
 	void johnson_jcp78_numerov(const double grid_step,
 	                           const double mass, const double tot_energy,
-	                           matrix *pot_energy, matrix *ratio, matrix *workspace);
+	                           const matrix *pot_energy, matrix *ratio, johnson_workspace *work);
+
+	double *johnson_jcp78_eigen(const matrix *pot_energy, matrix *eigenvec);
+
+	void johnson_jcp78_spectral(const double grid_step,
+	                            const double mass,
+	                            const double tot_energy,
+	                            const double eigenval[],
+	                            const matrix *eigenvec,
+	                            matrix *ratio,
+	                            johnson_workspace *work);
+
+	void johnson_jcp78_multi_numerov(const double grid_step,
+	                                 const double mass,
+	                                 const size_t max_energy,
+	                                 const double tot_energy[],
+	                                 const matrix *pot_energy,
+	                                 matrix *ratio[],
+	                                 matrix *eigenvec,
+	                                 johnson_workspace *work[],
+	                                 const bool use_omp);
+
+	void johnson_jcp78_lane_numerov(const size_t grid_size,
+	                                const double grid_step,
+	                                const double R_min,
+	                                const double mass,
+	                                const size_t max_lane,
+	                                const double tot_energy[],
+	                                const int l[],
+	                                const size_t start[],
+	                                void *params,
+	                                void (*pot_energy)(const double R, matrix *v, void *params),
+	                                matrix *ratio[]);
+
+	size_t johnson_wkb_start(const size_t grid_size,
+	                         const size_t max_ch,
+	                         const double grid_step,
+	                         const double mass,
+	                         const double tot_energy,
+	                         const double depth,
+	                         const double pot_energy[]);
 
 	void johnson_jcp73_logd(const int n,
 	                        const int grid_size,
 	                        const double grid_step,
 	                        const matrix *pot_energy,
-	                        matrix *y);
+	                        matrix *y,
+	                        johnson_workspace *work);
 
 	matrix *johnson_kmatrix(const int l[],
 	                        const double grid_step,
@@ -44,7 +139,45 @@
 	                        const double mass,
 	                        const double level[],
 	                        const matrix *ratio,
-	                        const double R);
+	                        const double R,
+	                        johnson_workspace *work);
+
+	matrix *johnson_logd_kmatrix(const int l[],
+	                             const double tot_energy,
+	                             const double mass,
+	                             const double level[],
+	                             const matrix *y,
+	                             const double R,
+	                             johnson_workspace *work);
+
+	smatrix *johnson_smatrix(const matrix *k, johnson_workspace *work);
+
+	smatrix *johnson_open_smatrix(const matrix *k,
+	                              const double level[],
+	                              const double tot_energy,
+	                              johnson_workspace *work);
+
+	void johnson_multi_kmatrix(const int l[],
+	                           const double grid_step,
+	                           const size_t max_energy,
+	                           const double tot_energy[],
+	                           const double mass,
+	                           const double level[],
+	                           matrix *ratio[],
+	                           const double R,
+	                           matrix *k[],
+	                           johnson_workspace *work[],
+	                           const bool use_omp);
 
-	smatrix *johnson_smatrix(const matrix *k);
+	void johnson_multi_smatrix(const int l[],
+	                           const double grid_step,
+	                           const size_t max_energy,
+	                           const double tot_energy[],
+	                           const double mass,
+	                           const double level[],
+	                           matrix *ratio[],
+	                           const double R[],
+	                           smatrix *s[],
+	                           johnson_workspace *work[],
+	                           const bool use_omp);
 #endif
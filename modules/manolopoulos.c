@@ -0,0 +1,761 @@
+/******************************************************************************
+
+ About
+ -----
+
+ This module is an implementation of the improved log derivative method of D.
+ E. Manolopoulos, Ref. [1], for the multichannel log derivative matrix Y. Each
+ sector uses a diagonal reference potential, taken at the sector midpoint, for
+ which the propagation is exact, and the remaining off-diagonal coupling is
+ handled by a Simpson-like quadrature as in the method of B. R. Johnson, Ref.
+ [2]. The sector width may be controlled by an estimate of the quadrature error,
+ see manolopoulos_logd().
+
+ Alternatively, the global propagator of a whole range of sectors can be built
+ independently of Y, as the four blocks y1, y2, y3 and y4 of
+
+ Y(b) = y4 - y3 [Y(a) + y1]^-1 y2,
+
+ for a range [a, b]. Propagators of adjacent ranges combine by an associative
+ product, see manolopoulos_sector_combine(), thus each range can be built by a
+ different process and then reduced in a log-depth tree.
+
+
+ References
+ ----------
+
+ [1] D. E. Manolopoulos J. Chem. Phys. 85, 6425 (1986)
+     doi: https://doi.org/10.1063/1.451472
+
+ [2] B. R. Johnson. J. Comp. Phys. 13, 445 (1973)
+     doi: https://doi.org/10.1016/0021-9991(73)90049-1
+
+******************************************************************************/
+
+#include "matrix.h"
+#include "johnson.h"
+#include "manolopoulos.h"
+
+/******************************************************************************
+
+ Function reference(): computes the diagonal reference potential, ref = 2m(V -
+ E), from the potential matrix v at the sector midpoint, and the respective
+ half-sector propagators y1 = y4 and y2 = y3 of Ref. [1] for a half-sector of
+ width h.
+
+ NOTE: for kh -> 0, both k coth(kh) and k cot(kh) tend to 1/h + ref*h/3, while
+ k/sinh(kh) and k/sin(kh) tend to 1/h - ref*h/6.
+
+******************************************************************************/
+
+inline static void reference(const double h,
+                             const double mass,
+                             const double tot_energy,
+                             const matrix *v,
+                             double ref[],
+                             double y1[],
+                             double y2[])
+{
+	const size_t max_ch = matrix_rows(v);
+
+	for (size_t j = 0; j < max_ch; ++j)
+	{
+		ref[j] = 2.0*mass*(matrix_get(v, j, j) - tot_energy);
+
+		const double k = sqrt(fabs(ref[j]));
+
+		if (k*h < 1.0E-4)
+		{
+			y1[j] = 1.0/h + ref[j]*h/3.0;
+			y2[j] = 1.0/h - ref[j]*h/6.0;
+		}
+		else if (ref[j] > 0.0)
+		{
+			y1[j] = k/tanh(k*h);
+			y2[j] = k/sinh(k*h);
+		}
+		else
+		{
+			y1[j] = k/tan(k*h);
+			y2[j] = k/sin(k*h);
+		}
+	}
+}
+
+/******************************************************************************
+
+ Function residual(): adds weight*U to y, where U = 2m(V - E) - ref is the part
+ of the coupling not included in the reference potential.
+
+******************************************************************************/
+
+inline static void residual(const double weight,
+                            const double mass,
+                            const double tot_energy,
+                            const matrix *v,
+                            const double ref[],
+                            matrix *y)
+{
+	const size_t max_ch = matrix_rows(v);
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		const double u_ii = 2.0*mass*(matrix_get(v, i, i) - tot_energy) - ref[i];
+
+		matrix_incr(y, i, i, weight*u_ii);
+
+		for (size_t j = (i + 1); j < max_ch; ++j)
+		{
+			const double u_ij = 2.0*mass*matrix_get(v, i, j);
+
+			matrix_incr(y, i, j, weight*u_ij);
+			matrix_incr(y, j, i, weight*u_ij);
+		}
+	}
+}
+
+/******************************************************************************
+
+ Function half_sector(): propagates y across a half-sector driven only by the
+ reference potential, Y = y4 - y3 (Y + y1)^-1 y2, where x is a workspace.
+
+******************************************************************************/
+
+inline static void half_sector(const double y1[],
+                               const double y2[],
+                               matrix *y,
+                               matrix *x,
+                               matrix_pivot *pivot)
+{
+	const size_t max_ch = matrix_rows(y);
+
+	matrix_copy(x, y, 1.0, 0.0);
+
+	for (size_t j = 0; j < max_ch; ++j)
+		matrix_incr(x, j, j, y1[j]);
+
+	matrix_inverse_pivot(x, pivot);
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		matrix_set_diag(y, i, y1[i] - y2[i]*matrix_get(x, i, i)*y2[i]);
+
+		for (size_t j = (i + 1); j < max_ch; ++j)
+			matrix_set_symm(y, i, j, -y2[i]*matrix_get(x, i, j)*y2[j]);
+	}
+}
+
+/******************************************************************************
+
+ Function midpoint(): adds to y the quadrature correction at the midpoint c of a
+ sector of width 2h, from Ref. [1] and [2],
+
+ Q(c) = (8/h){[I - (h^2/6)U(c)]^-1 - I},
+
+ where the diagonal of U(c) vanishes by construction of the reference and x is a
+ workspace.
+
+******************************************************************************/
+
+inline static void midpoint(const double h,
+                            const double mass,
+                            const matrix *v_c,
+                            matrix *y,
+                            matrix *x,
+                            matrix_pivot *pivot)
+{
+	const size_t max_ch = matrix_rows(y);
+
+	const double factor = h*h/6.0;
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		matrix_set_diag(x, i, 1.0);
+
+		for (size_t j = (i + 1); j < max_ch; ++j)
+			matrix_set_symm(x, i, j, -factor*2.0*mass*matrix_get(v_c, i, j));
+	}
+
+	matrix_inverse_pivot(x, pivot);
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		matrix_incr(y, i, i, (8.0/h)*(matrix_get(x, i, i) - 1.0));
+
+		for (size_t j = (i + 1); j < max_ch; ++j)
+		{
+			const double q = (8.0/h)*matrix_get(x, i, j);
+
+			matrix_incr(y, i, j, q);
+			matrix_incr(y, j, i, q);
+		}
+	}
+}
+
+/******************************************************************************
+
+ Function sector(): propagates y across a sector [a, b] of width 2h, where the
+ potential matrices at a, the midpoint c and b are given. The quadrature weights
+ are h/3 at a and b, whereas at c the correction of midpoint() is used.
+
+******************************************************************************/
+
+static void sector(const double h,
+                   const double mass,
+                   const double tot_energy,
+                   const matrix *v_a,
+                   const matrix *v_c,
+                   const matrix *v_b,
+                   double ref[],
+                   double y1[],
+                   double y2[],
+                   matrix *y,
+                   matrix *x,
+                   matrix_pivot *pivot)
+{
+	reference(h, mass, tot_energy, v_c, ref, y1, y2);
+
+	residual(h/3.0, mass, tot_energy, v_a, ref, y);
+
+	half_sector(y1, y2, y, x, pivot);
+
+	midpoint(h, mass, v_c, y, x, pivot);
+
+	half_sector(y1, y2, y, x, pivot);
+
+	residual(h/3.0, mass, tot_energy, v_b, ref, y);
+}
+
+/******************************************************************************
+
+ Function sector_error(): returns the error estimate of manolopoulos_logd() for
+ a sector of width 2h, where v[0], ..., v[4] is the potential at its ends,
+ quarters and midpoint, and ref is the reference potential at the midpoint.
+
+******************************************************************************/
+
+static double sector_error(const double h,
+                           const double mass,
+                           const double ref[],
+                           matrix *v[])
+{
+	const size_t max_ch = matrix_rows(v[0]);
+
+	const double s = 0.5*h, h5 = h*h*h*h*h/90.0;
+
+	double err = 0.0;
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		const double k_i = sqrt(fabs(ref[i]));
+
+		for (size_t j = i; j < max_ch; ++j)
+		{
+			const double k_j = sqrt(fabs(ref[j]));
+
+/*
+ *			Coupling U = 2m(V - E) - ref at each point and its derivatives
+ *			at the midpoint by finite differences:
+ */
+
+			double u[5];
+
+			for (size_t n = 0; n < 5; ++n)
+			{
+				u[n] = matrix_get(v[n], i, j);
+				if (i == j) u[n] -= matrix_get(v[2], i, i);
+				u[n] *= 2.0*mass;
+			}
+
+			const double d[5] =
+			{
+				fmax(fabs(u[0]), fmax(fabs(u[2]), fabs(u[4]))),
+				fabs(u[4] - u[0])/(4.0*s),
+				fabs(u[0] - 2.0*u[2] + u[4])/(4.0*s*s),
+				fabs(u[4] - 2.0*u[3] + 2.0*u[1] - u[0])/(2.0*s*s*s),
+				fabs(u[0] - 4.0*u[1] + 6.0*u[2] - 4.0*u[3] + u[4])/(s*s*s*s)
+			};
+
+			const double k = fmax(k_i, k_j);
+
+			const double f
+				= d[4] + k*(4.0*d[3] + k*(6.0*d[2] + k*(4.0*d[1] + k*d[0])));
+
+			const double q = fmax(k_i, 1.0/h)*fmax(k_j, 1.0/h);
+
+			err = fmax(err, h5*f/sqrt(q));
+		}
+	}
+
+	return err;
+}
+
+/******************************************************************************
+
+ Function manolopoulos_logd(): propagates the log derivative matrix y from R_min
+ to R_max, for a given total energy and reduced mass, where pot_energy(R, v,
+ params) must fill v with the potential matrix at R (asymptotic energies and
+ centrifugal terms included), e.g. interpolated from a grid. On entry, step is
+ the width of the first sector and, on exit, the width suggested for the next
+ one. The number of sectors is returned.
+
+ If tol > 0, the width 2h of each sector is chosen before it is built. The
+ coupling U = 2m(V - E) - ref, not included in the reference potential, is
+ integrated by a Simpson-like quadrature, with an error h^5 F/90, where F is
+ the fourth derivative of U times a solution of wavenumber k. Hence, with the
+ derivatives U(n) estimated by finite differences from the potential at five
+ equally spaced points (ends, quarters and midpoint of the sector),
+
+ err = max h^5 |F_ij|/[90 sqrt(q_i q_j)],
+
+ F = U(4) + 4k U(3) + 6k^2 U(2) + 4k^3 U(1) + k^4 U,
+
+ where k = max(k_i, k_j), k_i = sqrt|ref_i|, and q_i = max(k_i, 1/h), is the
+ phase error in each channel, as in alexander_airy(). The sector is built only
+ if err is below tol, otherwise it is retried with a smaller width. The next
+ width is scaled by 0.9(tol/err)^(1/5), within the range [0.2, 2.0], since the
+ method is of fourth order. Thus, each sector is built once, as for fixed
+ widths, at the cost of two extra potential evaluations per trial. Note that
+ tol bounds the error of each sector, not the accumulated one. Otherwise,
+ sectors of fixed width step are used.
+
+ NOTE: a workspace is allocated (and released) if work = NULL. The five matrices
+ for the potential at each sector are allocated once per call.
+
+******************************************************************************/
+
+size_t manolopoulos_logd(const double R_min,
+                         const double R_max,
+                         const double tot_energy,
+                         const double mass,
+                         const double tol,
+                         double *step,
+                         void *params,
+                         void (*pot_energy)(const double R, matrix *v, void *params),
+                         matrix *y,
+                         johnson_workspace *work)
+{
+	ASSERT(y != NULL)
+	ASSERT(step != NULL)
+	ASSERT(*step > 0.0)
+	ASSERT(R_max > R_min)
+	ASSERT(pot_energy != NULL)
+
+	const size_t max_ch = matrix_rows(y);
+
+	johnson_workspace *ws
+		= (work == NULL? johnson_workspace_alloc(max_ch) : work);
+
+	ASSERT(ws->max_ch == max_ch)
+
+	matrix *v[5];
+
+	for (size_t n = 0; n < 5; ++n)
+		v[n] = matrix_alloc(max_ch, max_ch, false);
+
+	double *ref = allocate(max_ch, sizeof(double), false);
+	double *y1 = allocate(max_ch, sizeof(double), false);
+	double *y2 = allocate(max_ch, sizeof(double), false);
+
+	matrix *x = ws->c;
+
+	pot_energy(R_min, v[0], params);
+
+	double R = R_min, h = 0.5*(*step), h_next = h;
+	size_t counter = 0;
+
+	while (R_max - R > 1.0E-12*(R_max - R_min))
+	{
+		h = fmin(h_next, 0.5*(R_max - R));
+
+		if (h < 1.0E-10*(R_max - R_min))
+		{
+			PRINT_ERROR("step too small (%e) at R = %f\n", 2.0*h, R)
+			exit(EXIT_FAILURE);
+		}
+
+		pot_energy(R + h, v[2], params);
+		pot_energy(R + 2.0*h, v[4], params);
+
+		bool accept = true;
+
+		if (tol > 0.0)
+		{
+			pot_energy(R + 0.5*h, v[1], params);
+			pot_energy(R + 1.5*h, v[3], params);
+
+			reference(h, mass, tot_energy, v[2], ref, y1, y2);
+
+			const double err = sector_error(h, mass, ref, v);
+
+			accept = (err <= tol);
+
+			const double scale
+				= (err > 0.0? 0.9*pow(tol/err, 0.2) : 2.0);
+
+			h_next = h*fmin(2.0, fmax(0.2, scale));
+		}
+
+		if (accept)
+		{
+			sector(h, mass, tot_energy,
+			       v[0], v[2], v[4], ref, y1, y2, y, x, ws->pivot);
+		}
+
+		if (accept)
+		{
+			R += 2.0*h;
+
+			matrix *swap = v[0];
+			v[0] = v[4];
+			v[4] = swap;
+
+			++counter;
+		}
+	}
+
+	*step = 2.0*h_next;
+
+	for (size_t n = 0; n < 5; ++n)
+		matrix_free(v[n]);
+
+	free(ref);
+	free(y1);
+	free(y2);
+
+	if (work == NULL) johnson_workspace_free(ws);
+
+	return counter;
+}
+
+/******************************************************************************
+
+ Function manolopoulos_sector_alloc(): allocates the global propagator of a range
+ of sectors for max_ch channels. It starts empty, i.e. as the identity, in which
+ case y1 holds any term added to Y before the first half-sector.
+
+******************************************************************************/
+
+manolopoulos_sector *manolopoulos_sector_alloc(const size_t max_ch)
+{
+	ASSERT(max_ch > 0)
+
+	manolopoulos_sector *s = allocate(1, sizeof(manolopoulos_sector), true);
+
+	s->max_ch = max_ch;
+	s->empty = true;
+
+	s->y1 = matrix_alloc(max_ch, max_ch, true);
+	s->y2 = matrix_alloc(max_ch, max_ch, false);
+	s->y3 = matrix_alloc(max_ch, max_ch, false);
+	s->y4 = matrix_alloc(max_ch, max_ch, false);
+
+	return s;
+}
+
+/******************************************************************************
+
+ Function manolopoulos_sector_free(): release resources allocated by
+ manolopoulos_sector_alloc().
+
+******************************************************************************/
+
+void manolopoulos_sector_free(manolopoulos_sector *s)
+{
+	matrix_free(s->y1);
+	matrix_free(s->y2);
+	matrix_free(s->y3);
+	matrix_free(s->y4);
+
+	free(s);
+}
+
+/******************************************************************************
+
+ Function manolopoulos_sector_reset(): makes s empty again, i.e. the identity.
+
+******************************************************************************/
+
+void manolopoulos_sector_reset(manolopoulos_sector *s)
+{
+	s->empty = true;
+	matrix_set_zero(s->y1);
+}
+
+/******************************************************************************
+
+ Function sector_term(): returns the matrix of s to which additive terms of Y are
+ accumulated, i.e. y4, or y1 if s is still empty.
+
+******************************************************************************/
+
+inline static matrix *sector_term(manolopoulos_sector *s)
+{
+	return (s->empty? s->y1 : s->y4);
+}
+
+/******************************************************************************
+
+ Function sector_half(): appends to s the half-sector propagator of diagonal
+ blocks y1 = y4 and y2 = y3, as given by reference(). For a non-empty s, it is
+ the product of manolopoulos_sector_combine() with b1 = b4 and b2 = b3 diagonal,
+
+ W = (a4 + b1)^-1,
+
+ a1 = a1 - a2 W a3, a2 = a2 W b2, a3 = b2 W a3, a4 = b1 - b2 W b2.
+
+******************************************************************************/
+
+static void sector_half(const double y1[],
+                        const double y2[],
+                        manolopoulos_sector *s,
+                        johnson_workspace *work)
+{
+	const size_t max_ch = s->max_ch;
+
+	if (s->empty)
+	{
+		matrix_set_zero(s->y2);
+		matrix_set_zero(s->y3);
+		matrix_set_zero(s->y4);
+
+		for (size_t j = 0; j < max_ch; ++j)
+		{
+			matrix_incr(s->y1, j, j, y1[j]);
+			matrix_set(s->y2, j, j, y2[j]);
+			matrix_set(s->y3, j, j, y2[j]);
+			matrix_set(s->y4, j, j, y1[j]);
+		}
+
+		s->empty = false;
+		return;
+	}
+
+	matrix *w = work->a, *t = work->b, *u = work->c;
+
+	matrix_copy(w, s->y4, 1.0, 0.0);
+
+	for (size_t j = 0; j < max_ch; ++j)
+		matrix_incr(w, j, j, y1[j]);
+
+	matrix_inverse_pivot(w, work->pivot);
+
+	matrix_multiply(1.0, w, s->y3, 0.0, t);
+	matrix_multiply(1.0, s->y2, w, 0.0, u);
+
+	matrix_multiply(-1.0, s->y2, t, 1.0, s->y1);
+
+	for (size_t j = 0; j < max_ch; ++j)
+	{
+		matrix_scale_col(u, j, y2[j]);
+		matrix_scale_row(t, j, y2[j]);
+	}
+
+	matrix_swap(s->y2, u);
+	matrix_swap(s->y3, t);
+
+	for (size_t i = 0; i < max_ch; ++i)
+		for (size_t j = 0; j < max_ch; ++j)
+			matrix_set(s->y4, i, j, (i == j? y1[i] : 0.0) - y2[i]*matrix_get(w, i, j)*y2[j]);
+}
+
+/******************************************************************************
+
+ Function manolopoulos_sector_build(): builds in s the global propagator from
+ R_min to R_max, for a given total energy and reduced mass, by sectors of equal
+ width, the largest not above step. Each sector is as in manolopoulos_logd()
+ with tol = 0, and pot_energy and params are as there. The number of sectors is
+ returned.
+
+ NOTE: each sector costs about three times a step of manolopoulos_logd(), which
+ is the price for not depending on Y at R_min.
+
+******************************************************************************/
+
+size_t manolopoulos_sector_build(const double R_min,
+                                 const double R_max,
+                                 const double tot_energy,
+                                 const double mass,
+                                 const double step,
+                                 void *params,
+                                 void (*pot_energy)(const double R, matrix *v, void *params),
+                                 manolopoulos_sector *s,
+                                 johnson_workspace *work)
+{
+	ASSERT(s != NULL)
+	ASSERT(step > 0.0)
+	ASSERT(R_max > R_min)
+	ASSERT(pot_energy != NULL)
+
+	const size_t max_ch = s->max_ch;
+
+	johnson_workspace *ws
+		= (work == NULL? johnson_workspace_alloc(max_ch) : work);
+
+	ASSERT(ws->max_ch == max_ch)
+
+	const size_t max_sector = (size_t) ceil((R_max - R_min)/step - 1.0E-10);
+
+	const double h = 0.5*(R_max - R_min)/as_double(max_sector);
+
+	matrix *v_a = matrix_alloc(max_ch, max_ch, false);
+	matrix *v_c = matrix_alloc(max_ch, max_ch, false);
+	matrix *v_b = matrix_alloc(max_ch, max_ch, false);
+
+	double *ref = allocate(max_ch, sizeof(double), false);
+	double *y1 = allocate(max_ch, sizeof(double), false);
+	double *y2 = allocate(max_ch, sizeof(double), false);
+
+	manolopoulos_sector_reset(s);
+
+	pot_energy(R_min, v_a, params);
+
+	for (size_t n = 0; n < max_sector; ++n)
+	{
+		const double R = R_min + 2.0*h*as_double(n);
+
+		pot_energy(R + h, v_c, params);
+		pot_energy(R + 2.0*h, v_b, params);
+
+		reference(h, mass, tot_energy, v_c, ref, y1, y2);
+
+		residual(h/3.0, mass, tot_energy, v_a, ref, sector_term(s));
+
+		sector_half(y1, y2, s, ws);
+
+		midpoint(h, mass, v_c, s->y4, ws->a, ws->pivot);
+
+		sector_half(y1, y2, s, ws);
+
+		residual(h/3.0, mass, tot_energy, v_b, ref, s->y4);
+
+		matrix *swap = v_a;
+		v_a = v_b;
+		v_b = swap;
+	}
+
+	matrix_free(v_a);
+	matrix_free(v_c);
+	matrix_free(v_b);
+
+	free(ref);
+	free(y1);
+	free(y2);
+
+	if (work == NULL) johnson_workspace_free(ws);
+
+	return max_sector;
+}
+
+/******************************************************************************
+
+ Function manolopoulos_sector_combine(): replaces a, the propagator of a range
+ [R_a, R_b], by the one of [R_a, R_c], where b is the propagator of [R_b, R_c].
+ From the elimination of Y(R_b),
+
+ W = (a4 + b1)^-1,
+
+ a1 = a1 - a2 W a3, a2 = a2 W b2, a3 = b3 W a3, a4 = b4 - b3 W b2,
+
+ which is associative. Thus, many ranges can be combined in any grouping, as
+ long as the order is kept.
+
+******************************************************************************/
+
+void manolopoulos_sector_combine(manolopoulos_sector *a,
+                                 const manolopoulos_sector *b,
+                                 johnson_workspace *work)
+{
+	ASSERT(a != NULL)
+	ASSERT(b != NULL)
+	ASSERT(a->max_ch == b->max_ch)
+
+	if (b->empty)
+	{
+		matrix *term = sector_term(a);
+		matrix_add(1.0, term, 1.0, b->y1, term);
+		return;
+	}
+
+	if (a->empty)
+	{
+		matrix_add(1.0, a->y1, 1.0, b->y1, a->y1);
+		matrix_copy(a->y2, b->y2, 1.0, 0.0);
+		matrix_copy(a->y3, b->y3, 1.0, 0.0);
+		matrix_copy(a->y4, b->y4, 1.0, 0.0);
+
+		a->empty = false;
+		return;
+	}
+
+	johnson_workspace *ws
+		= (work == NULL? johnson_workspace_alloc(a->max_ch) : work);
+
+	ASSERT(ws->max_ch == a->max_ch)
+
+	matrix *w = ws->a, *t = ws->b, *u = ws->c, *x = ws->d;
+
+	matrix_copy(w, a->y4, 1.0, 0.0);
+	matrix_add(1.0, w, 1.0, b->y1, w);
+
+	matrix_inverse_pivot(w, ws->pivot);
+
+	matrix_multiply(1.0, w, a->y3, 0.0, t);
+	matrix_multiply(1.0, a->y2, w, 0.0, u);
+
+	matrix_multiply(-1.0, a->y2, t, 1.0, a->y1);
+
+	matrix_multiply(1.0, u, b->y2, 0.0, x);
+	matrix_swap(a->y2, x);
+
+	matrix_multiply(1.0, b->y3, t, 0.0, x);
+	matrix_swap(a->y3, x);
+
+	matrix_multiply(1.0, b->y3, w, 0.0, u);
+
+	matrix_copy(a->y4, b->y4, 1.0, 0.0);
+	matrix_multiply(-1.0, u, b->y2, 1.0, a->y4);
+
+	if (work == NULL) johnson_workspace_free(ws);
+}
+
+/******************************************************************************
+
+ Function manolopoulos_sector_apply(): propagates y across the range of s, i.e.
+ Y = y4 - y3 (Y + y1)^-1 y2.
+
+******************************************************************************/
+
+void manolopoulos_sector_apply(const manolopoulos_sector *s,
+                               matrix *y,
+                               johnson_workspace *work)
+{
+	ASSERT(s != NULL)
+	ASSERT(y != NULL)
+	ASSERT(matrix_rows(y) == s->max_ch)
+
+	if (s->empty)
+	{
+		matrix_add(1.0, y, 1.0, s->y1, y);
+		return;
+	}
+
+	johnson_workspace *ws
+		= (work == NULL? johnson_workspace_alloc(s->max_ch) : work);
+
+	ASSERT(ws->max_ch == s->max_ch)
+
+	matrix *x = ws->a, *z = ws->b;
+
+	matrix_copy(x, y, 1.0, 0.0);
+	matrix_add(1.0, x, 1.0, s->y1, x);
+
+	matrix_copy(z, s->y2, 1.0, 0.0);
+
+	matrix_solve(x, z, ws->pivot);
+
+	matrix_copy(y, s->y4, 1.0, 0.0);
+	matrix_multiply(-1.0, s->y3, z, 1.0, y);
+
+	if (work == NULL) johnson_workspace_free(ws);
+}
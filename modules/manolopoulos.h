@@ -0,0 +1,50 @@
+#if !defined(MANOLOPOULOS_HEADER)
+	#define MANOLOPOULOS_HEADER
+	#include "globals.h"
+	#include "matrix.h"
+	#include "johnson.h"
+
+	struct manolopoulos_sector
+	{
+		size_t max_ch;
+		bool empty;
+		matrix *y1, *y2, *y3, *y4;
+	};
+
+	typedef struct manolopoulos_sector manolopoulos_sector;
+
+	size_t manolopoulos_logd(const double R_min,
+	                         const double R_max,
+	                         const double tot_energy,
+	                         const double mass,
+	                         const double tol,
+	                         double *step,
+	                         void *params,
+	                         void (*pot_energy)(const double R, matrix *v, void *params),
+	                         matrix *y,
+	                         johnson_workspace *work);
+
+	manolopoulos_sector *manolopoulos_sector_alloc(const size_t max_ch);
+
+	void manolopoulos_sector_free(manolopoulos_sector *s);
+
+	void manolopoulos_sector_reset(manolopoulos_sector *s);
+
+	size_t manolopoulos_sector_build(const double R_min,
+	                                 const double R_max,
+	                                 const double tot_energy,
+	                                 const double mass,
+	                                 const double step,
+	                                 void *params,
+	                                 void (*pot_energy)(const double R, matrix *v, void *params),
+	                                 manolopoulos_sector *s,
+	                                 johnson_workspace *work);
+
+	void manolopoulos_sector_combine(manolopoulos_sector *a,
+	                                 const manolopoulos_sector *b,
+	                                 johnson_workspace *work);
+
+	void manolopoulos_sector_apply(const manolopoulos_sector *s,
+	                               matrix *y,
+	                               johnson_workspace *work);
+#endif
@@ -995,6 +995,32 @@ void matrix_multiply(const double alpha,
 	            a->max_row, b->data, a->max_col, beta, c->data, c->max_row);
 }
 
+/******************************************************************************
+
+ Function matrix_multiply_trans(): the same as matrix_multiply() but any of the
+ operands can be transposed, c = alpha*op(a)*op(b) + beta*c. Where, op(a) = a^T
+ if trans_a = 't' or op(a) = a if trans_a = 'n', and likewise for b.
+
+******************************************************************************/
+
+void matrix_multiply_trans(const double alpha,
+                           const char trans_a,
+                           const matrix *a,
+                           const char trans_b,
+                           const matrix *b,
+                           const double beta,
+                           matrix *c)
+{
+	const size_t k = (trans_a == 't'? a->max_row : a->max_col);
+
+	ASSERT(c->max_row == (trans_a == 't'? a->max_col : a->max_row))
+	ASSERT(c->max_col == (trans_b == 't'? b->max_row : b->max_col))
+	ASSERT(k == (trans_b == 't'? b->max_col : b->max_row))
+
+	call_dgemm(trans_a, trans_b, c->max_row, c->max_col, k, alpha, a->data,
+	           a->max_col, b->data, b->max_col, beta, c->data, c->max_col);
+}
+
 /******************************************************************************
 
  Function matrix_add(): perform the operation c = a*alpha + b*beta.
@@ -1029,6 +1055,80 @@ void matrix_sub(const double alpha, const matrix *a,
 		c->data[n] = a->data[n]*alpha - b->data[n]*beta;
 }
 
+/******************************************************************************
+
+ Type matrix_pivot: the pivot indices (and, for GSL, the LU buffer) needed by
+ matrix_inverse_pivot(). It can be allocated once, for the largest matrix,
+ and reused in order to avoid heap allocations inside propagation loops.
+
+******************************************************************************/
+
+struct matrix_pivot
+{
+	size_t max_row;
+
+	#if defined(USE_MAGMA)
+		magma_int_t *ipiv;
+	#elif defined(USE_LAPACKE)
+		int *ipiv;
+	#elif defined(USE_MKL)
+		long long int *ipiv;
+	#else
+		size_t *ipiv;
+		double *buffer;
+	#endif
+};
+
+/******************************************************************************
+
+ Function matrix_pivot_alloc(): allocate resources for the pivots of square
+ matrices up to max_row rows.
+
+******************************************************************************/
+
+matrix_pivot *matrix_pivot_alloc(const size_t max_row)
+{
+	ASSERT(max_row > 0)
+
+	matrix_pivot *pivot = allocate(1, sizeof(matrix_pivot), true);
+
+	pivot->max_row = max_row;
+
+	#if defined(USE_MAGMA)
+		magma_imalloc_cpu(&pivot->ipiv, max_row);
+	#else
+		pivot->ipiv = allocate(max_row, sizeof(pivot->ipiv[0]), false);
+	#endif
+
+	#if !defined(USE_MAGMA) && !defined(USE_MKL) && !defined(USE_LAPACKE)
+		pivot->buffer = allocate(max_row*max_row, sizeof(double), false);
+	#endif
+
+	return pivot;
+}
+
+/******************************************************************************
+
+ Function matrix_pivot_free(): release resources allocated by
+ matrix_pivot_alloc().
+
+******************************************************************************/
+
+void matrix_pivot_free(matrix_pivot *pivot)
+{
+	#if defined(USE_MAGMA)
+		magma_free_cpu(pivot->ipiv);
+	#else
+		free(pivot->ipiv);
+	#endif
+
+	#if !defined(USE_MAGMA) && !defined(USE_MKL) && !defined(USE_LAPACKE)
+		free(pivot->buffer);
+	#endif
+
+	free(pivot);
+}
+
 /******************************************************************************
 
  Function matrix_inverse(): to invert the matrix m.
@@ -1037,10 +1137,31 @@ void matrix_sub(const double alpha, const matrix *a,
 
 void matrix_inverse(matrix *m)
 {
+	matrix_pivot *pivot = matrix_pivot_alloc(m->max_row);
+
+	matrix_inverse_pivot(m, pivot);
+
+	matrix_pivot_free(pivot);
+}
+
+/******************************************************************************
+
+ Function matrix_inverse_pivot(): the same as matrix_inverse() but using the
+ resources of a given pivot, as allocated by matrix_pivot_alloc().
+
+ NOTE: with MAGMA, the device buffers are still allocated at each call.
+
+******************************************************************************/
+
+void matrix_inverse_pivot(matrix *m, matrix_pivot *pivot)
+{
+	ASSERT(pivot != NULL)
+	ASSERT(m->max_row == m->max_col)
+	ASSERT(m->max_row <= pivot->max_row)
+
 	#if defined(USE_MAGMA)
 	{
-		magma_int_t *ipiv = NULL;
-		magma_imalloc_cpu(&ipiv, min(m->max_row, m->max_col));
+		magma_int_t *ipiv = pivot->ipiv;
 
 		double *m_gpu = NULL;
 		magma_dmalloc(&m_gpu, m->max_row*m->max_col);
@@ -1075,22 +1196,13 @@ void matrix_inverse(matrix *m)
 		magma_getmatrix(m->max_row, m->max_col, sizeof(double),
 		                m_gpu, m->max_row, m->data, m->max_row, gpu_queue);
 
-		magma_free(ipiv);
 		magma_free(work);
 		magma_free(m_gpu);
 	}
 	#elif defined(USE_MKL) || defined(USE_LAPACKE)
 	{
-		#if defined(USE_LAPACKE)
-			int *ipiv = malloc(sizeof(int)*m->max_row);
-		#else
-			long long int *ipiv = malloc(sizeof(long long int)*m->max_row);
-		#endif
-
-		ASSERT(ipiv != NULL)
-
 		int info = LAPACKE_dsytrf(LAPACK_ROW_MAJOR, 'u', m->max_row,
-		                                 m->data, m->max_row, ipiv);
+		                                 m->data, m->max_row, pivot->ipiv);
 
 		if (info != 0)
 		{
@@ -1099,7 +1211,7 @@ void matrix_inverse(matrix *m)
 		}
 
 		info = LAPACKE_dsytri(LAPACK_ROW_MAJOR, 'u', m->max_row,
-		                             m->data, m->max_row, ipiv);
+		                             m->data, m->max_row, pivot->ipiv);
 
 		if (info != 0)
 		{
@@ -1115,26 +1227,239 @@ void matrix_inverse(matrix *m)
 		for (size_t p = 0; p < m->max_row; ++p)
 			for (size_t q = (p + 1); q < m->max_col; ++q)
 				DATA_OFFSET(m, q, p) = DATA_OFFSET(m, p, q);
-
-		free(ipiv);
 	}
 	#else
 	{
-		double *buffer = allocate(m->max_row*m->max_col, sizeof(double), false);
-
 		for (size_t n = 0; n < m->max_row*m->max_col; ++n)
-			buffer[n] = m->data[n];
+			pivot->buffer[n] = m->data[n];
+
+		/* NOTE: a permutation view of the first max_row pivots. */
+		gsl_permutation p = {m->max_row, pivot->ipiv};
 
-		gsl_permutation *p = gsl_permutation_alloc(m->max_row);
-		gsl_matrix_view  a = gsl_matrix_view_array(buffer, m->max_row, m->max_col);
-		gsl_matrix_view  b = gsl_matrix_view_array(m->data, m->max_row, m->max_col);
+		gsl_matrix_view a = gsl_matrix_view_array(pivot->buffer, m->max_row, m->max_col);
+		gsl_matrix_view b = gsl_matrix_view_array(m->data, m->max_row, m->max_col);
 
 		int sign = 0;
-		gsl_linalg_LU_decomp(&a.matrix, p, &sign);
-		gsl_linalg_LU_invert(&a.matrix, p, &b.matrix);
+		gsl_linalg_LU_decomp(&a.matrix, &p, &sign);
+		gsl_linalg_LU_invert(&a.matrix, &p, &b.matrix);
+	}
+	#endif
+}
+
+/******************************************************************************
+
+ Function matrix_solve(): solves the linear system a*x = b, for a general square
+ matrix a and as many right-hand sides as columns of b. On exit, b is replaced
+ by the solution x and a by its LU factorization. If pivot = NULL, the resources
+ needed are allocated (and released) internally.
+
+ NOTE: it is cheaper and more accurate than matrix_inverse() followed by a
+ matrix_multiply(). With MAGMA, the latter is used instead.
+
+******************************************************************************/
 
-		gsl_permutation_free(p);
-		free(buffer);
+void matrix_solve(matrix *a, matrix *b, matrix_pivot *pivot)
+{
+	ASSERT(a->max_row == a->max_col)
+	ASSERT(a->max_row == b->max_row)
+
+	matrix_pivot *p
+		= (pivot == NULL? matrix_pivot_alloc(a->max_row) : pivot);
+
+	ASSERT(a->max_row <= p->max_row)
+
+	#if defined(USE_MAGMA)
+	{
+		matrix_inverse_pivot(a, p);
+
+		matrix *x = matrix_alloc_as(b, false);
+
+		matrix_multiply_trans(1.0, 'n', a, 'n', b, 0.0, x);
+		matrix_swap(b, x);
+
+		matrix_free(x);
+	}
+	#elif defined(USE_MKL) || defined(USE_LAPACKE)
+	{
+		const int info = LAPACKE_dgesv(LAPACK_ROW_MAJOR, a->max_row, b->max_col,
+		                               a->data, a->max_col, p->ipiv, b->data, b->max_col);
+
+		if (info != 0)
+		{
+			PRINT_ERROR("LAPACKE_dgesv() failed with error code %d\n", info)
+			exit(EXIT_FAILURE);
+		}
+	}
+	#else
+	{
+		ASSERT(b->max_col <= p->max_row)
+
+		gsl_permutation q = {a->max_row, p->ipiv};
+		gsl_matrix_view lu = gsl_matrix_view_array(a->data, a->max_row, a->max_col);
+
+		int sign = 0;
+		gsl_linalg_LU_decomp(&lu.matrix, &q, &sign);
+
+/*
+ *		Solve L*U*x = P*b, where the rows of b are permuted into the buffer:
+ */
+
+		for (size_t n = 0; n < b->max_row; ++n)
+			for (size_t m = 0; m < b->max_col; ++m)
+				p->buffer[n*b->max_col + m] = DATA_OFFSET(b, q.data[n], m);
+
+		cblas_dtrsm(CblasRowMajor, CblasLeft, CblasLower, CblasNoTrans, CblasUnit,
+		            b->max_row, b->max_col, 1.0, a->data, a->max_col, p->buffer, b->max_col);
+
+		cblas_dtrsm(CblasRowMajor, CblasLeft, CblasUpper, CblasNoTrans, CblasNonUnit,
+		            b->max_row, b->max_col, 1.0, a->data, a->max_col, p->buffer, b->max_col);
+
+		for (size_t n = 0; n < b->max_row*b->max_col; ++n)
+			b->data[n] = p->buffer[n];
+	}
+	#endif
+
+	if (pivot == NULL) matrix_pivot_free(p);
+}
+
+/******************************************************************************
+
+ Function matrix_symm_solve(): the same as matrix_solve() but for a symmetric
+ matrix a, whose factorization is then symmetric-aware with MKL or LAPACKE.
+
+******************************************************************************/
+
+void matrix_symm_solve(matrix *a, matrix *b, matrix_pivot *pivot)
+{
+	#if defined(USE_MKL) || defined(USE_LAPACKE)
+	{
+		ASSERT(a->max_row == a->max_col)
+		ASSERT(a->max_row == b->max_row)
+
+		matrix_pivot *p
+			= (pivot == NULL? matrix_pivot_alloc(a->max_row) : pivot);
+
+		ASSERT(a->max_row <= p->max_row)
+
+		const int info = LAPACKE_dsysv(LAPACK_ROW_MAJOR, 'u', a->max_row, b->max_col,
+		                               a->data, a->max_col, p->ipiv, b->data, b->max_col);
+
+		if (info != 0)
+		{
+			PRINT_ERROR("LAPACKE_dsysv() failed with error code %d\n", info)
+			exit(EXIT_FAILURE);
+		}
+
+		if (pivot == NULL) matrix_pivot_free(p);
+	}
+	#else
+		matrix_solve(a, b, pivot);
+	#endif
+}
+
+/******************************************************************************
+
+ Function matrix_complex_solve(): solves the complex linear system a*x = b, for
+ n-by-n a and n-by-n_rhs b, both row-major arrays. On exit, b is replaced by x
+ and a by its LU factorization. Optionally, pivot is a workspace (if not NULL)
+ for the pivots, used with MKL or LAPACKE only.
+
+ NOTE: otherwise, a builtin Gaussian elimination with partial pivoting is used,
+ which has no complex counterpart in the GSL interface of matrix.
+
+******************************************************************************/
+
+void matrix_complex_solve(const size_t n,
+                          const size_t n_rhs,
+                          double complex a[],
+                          double complex b[],
+                          matrix_pivot *pivot)
+{
+	ASSERT(a != NULL)
+	ASSERT(b != NULL)
+
+	#if defined(USE_MKL) || defined(USE_LAPACKE)
+	{
+		matrix_pivot *p
+			= (pivot == NULL? matrix_pivot_alloc(n) : pivot);
+
+		ASSERT(n <= p->max_row)
+
+		const int info = LAPACKE_zgesv(LAPACK_ROW_MAJOR, n, n_rhs, (lapack_complex_double *) a,
+		                               n, p->ipiv, (lapack_complex_double *) b, n_rhs);
+
+		if (info != 0)
+		{
+			PRINT_ERROR("LAPACKE_zgesv() failed with error code %d\n", info)
+			exit(EXIT_FAILURE);
+		}
+
+		if (pivot == NULL) matrix_pivot_free(p);
+	}
+	#else
+	{
+		(void) pivot;
+
+		for (size_t k = 0; k < n; ++k)
+		{
+			size_t p = k;
+
+			for (size_t i = (k + 1); i < n; ++i)
+				if (cabs(a[i*n + k]) > cabs(a[p*n + k])) p = i;
+
+			if (a[p*n + k] == 0.0)
+			{
+				PRINT_ERROR("singular matrix at column %zu\n", k)
+				exit(EXIT_FAILURE);
+			}
+
+			if (p != k)
+			{
+				for (size_t j = 0; j < n; ++j)
+				{
+					const double complex x = a[k*n + j];
+					a[k*n + j] = a[p*n + j];
+					a[p*n + j] = x;
+				}
+
+				for (size_t j = 0; j < n_rhs; ++j)
+				{
+					const double complex x = b[k*n_rhs + j];
+					b[k*n_rhs + j] = b[p*n_rhs + j];
+					b[p*n_rhs + j] = x;
+				}
+			}
+
+			for (size_t i = (k + 1); i < n; ++i)
+			{
+				const double complex factor = a[i*n + k]/a[k*n + k];
+
+				a[i*n + k] = factor;
+
+				for (size_t j = (k + 1); j < n; ++j)
+					a[i*n + j] -= factor*a[k*n + j];
+
+				for (size_t j = 0; j < n_rhs; ++j)
+					b[i*n_rhs + j] -= factor*b[k*n_rhs + j];
+			}
+		}
+
+/*
+ *		Back substitution:
+ */
+
+		for (size_t i = (n - 1); i < n; --i)
+		{
+			for (size_t j = 0; j < n_rhs; ++j)
+			{
+				double complex x = b[i*n_rhs + j];
+
+				for (size_t m = (i + 1); m < n; ++m)
+					x -= a[i*n + m]*b[m*n_rhs + j];
+
+				b[i*n_rhs + j] = x/a[i*n + i];
+			}
+		}
 	}
 	#endif
 }
@@ -1156,6 +1481,343 @@ double *matrix_symm_eigen(matrix *m, const char job)
 	return eigenval;
 }
 
+/******************************************************************************
+
+ Function orthonormal_append(): orthogonalize (twice) a vector x of length n
+ against the first s columns of the row-major n-by-s_max array base and, if x
+ is not linearly dependent of them, append its normalized form as the column s.
+ Return the new number of columns.
+
+******************************************************************************/
+
+static size_t orthonormal_append(const size_t n, const size_t s,
+                                 const size_t s_max, double base[], double x[])
+{
+	double norm = 0.0;
+	for (size_t i = 0; i < n; ++i)
+		norm += x[i]*x[i];
+
+	const double x_norm = sqrt(norm);
+
+	for (size_t pass = 0; pass < 2; ++pass)
+	{
+		for (size_t q = 0; q < s; ++q)
+		{
+			double dot = 0.0;
+			for (size_t i = 0; i < n; ++i)
+				dot += base[i*s_max + q]*x[i];
+
+			for (size_t i = 0; i < n; ++i)
+				x[i] -= dot*base[i*s_max + q];
+		}
+	}
+
+	norm = 0.0;
+	for (size_t i = 0; i < n; ++i)
+		norm += x[i]*x[i];
+
+	norm = sqrt(norm);
+
+	if (norm < 1.0E-8*x_norm || norm < 1.0E-14) return s;
+
+	for (size_t i = 0; i < n; ++i)
+		base[i*s_max + s] = x[i]/norm;
+
+	return s + 1;
+}
+
+/******************************************************************************
+
+ Function precondition(): apply to a vector x the preconditioner (m0 - theta)^-1
+ used by matrix_symm_partial_eigen(), where m0 = ref*diag(ref_eigenval)*ref^T if
+ ref is not null or m0 = diag(m) otherwise. Where, work is a buffer of the same
+ length of x.
+
+******************************************************************************/
+
+static void precondition(const matrix *m,
+                         const matrix *ref,
+                         const double ref_eigenval[],
+                         const double theta,
+                         double x[],
+                         double work[])
+{
+	const size_t n = m->max_row;
+
+	if (ref == NULL)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			double d = DATA_OFFSET(m, i, i) - theta;
+			if (fabs(d) < 1.0E-8) d = (d < 0.0? -1.0E-8 : 1.0E-8);
+
+			x[i] = x[i]/d;
+		}
+
+		return;
+	}
+
+	call_dgemm('t', 'n', n, 1, n, 1.0, ref->data, n, x, 1, 0.0, work, 1);
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		double d = ref_eigenval[i] - theta;
+		if (fabs(d) < 1.0E-8) d = (d < 0.0? -1.0E-8 : 1.0E-8);
+
+		work[i] = work[i]/d;
+	}
+
+	call_dgemm('n', 'n', n, 1, n, 1.0, ref->data, n, work, 1, 0.0, x, 1);
+}
+
+/******************************************************************************
+
+ Function matrix_symm_partial_eigen(): return the k lowest eigenvalues of a
+ symmetric n-by-n matrix m, where k is the number of columns of v, using the
+ block Davidson method. On entry, the columns of v are the starting guesses,
+ e.g. eigenvectors of a similar matrix, and on exit they are replaced by the
+ respective eigenvectors. Iterations stop once every residual norm |m*v -
+ eigenval*v| is below tol. If not converged after max_step iterations, a dense
+ diagonalization of m is used instead.
+
+ The residuals are preconditioned by (ref_eigenval - theta)^-1 in the basis of
+ ref, whose columns are the eigenvectors of a nearby matrix (e.g. m up to a
+ small diagonal shift). If ref is null, the diagonal of m is used instead.
+
+ NOTE: null or linearly dependent guesses are replaced by unit vectors, thus v
+ may be set to zero if no guess is available. Unlike matrix_symm_eigen(), the
+ eigenvectors are columns of v for any library in use.
+
+******************************************************************************/
+
+double *matrix_symm_partial_eigen(const matrix *m,
+                                  matrix *v,
+                                  const matrix *ref,
+                                  const double ref_eigenval[],
+                                  const double tol,
+                                  const size_t max_step)
+{
+	ASSERT(m->max_row == m->max_col)
+	ASSERT(v->max_row == m->max_row)
+	ASSERT(v->max_col > 0)
+	ASSERT(v->max_col <= m->max_row)
+
+	if (ref != NULL)
+	{
+		ASSERT(ref_eigenval != NULL)
+		ASSERT(ref->max_row == m->max_row)
+		ASSERT(ref->max_col == m->max_col)
+	}
+
+	const size_t n = m->max_row, k = v->max_col;
+	const size_t s_max = min(n, 4*k);
+
+	double *eigenval = allocate(k, sizeof(double), false);
+
+	bool converged = false;
+
+	if (s_max >= 2*k)
+	{
+		double *base = allocate(n*s_max, sizeof(double), false);
+		double *image = allocate(n*s_max, sizeof(double), false);
+		double *h = allocate(s_max*s_max, sizeof(double), false);
+		double *theta = allocate(s_max, sizeof(double), false);
+		double *x = allocate(n*k, sizeof(double), false);
+		double *ax = allocate(n*k, sizeof(double), false);
+		double *t = allocate(n, sizeof(double), false);
+		double *u = allocate(n, sizeof(double), false);
+		double *work = allocate(n, sizeof(double), false);
+		bool *seeded = allocate(n, sizeof(bool), true);
+
+/*
+ *		Orthonormal starting basis from the guesses (or unit vectors):
+ */
+
+		size_t s = 0;
+		for (size_t q = 0; q < k; ++q)
+		{
+			for (size_t i = 0; i < n; ++i)
+				t[i] = DATA_OFFSET(v, i, q);
+
+			s = orthonormal_append(n, s, s_max, base, t);
+		}
+
+		while (s < k)
+		{
+			size_t i_min = 0;
+			double d_min = INF;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (!seeded[i] && DATA_OFFSET(m, i, i) < d_min)
+				{
+					d_min = DATA_OFFSET(m, i, i);
+					i_min = i;
+				}
+			}
+
+			seeded[i_min] = true;
+
+			for (size_t i = 0; i < n; ++i)
+				t[i] = (i == i_min? 1.0 : 0.0);
+
+			s = orthonormal_append(n, s, s_max, base, t);
+		}
+
+		call_dgemm('n', 'n', n, s, n, 1.0, m->data, n, base, s_max, 0.0, image, s_max);
+
+		for (size_t step = 0; step < max_step; ++step)
+		{
+/*
+ *			Rayleigh-Ritz in the subspace: h = base^T m base.
+ */
+
+			call_dgemm('t', 'n', s, s, n, 1.0, base, s_max, image, s_max, 0.0, h, s);
+
+			call_dsyev('v', 'l', s, h, s, theta);
+
+			#if defined(USE_MAGMA)
+				/* NOTE: eigenvectors are rows when MAGMA is used. */
+				for (size_t p = 0; p < s; ++p)
+					for (size_t q = (p + 1); q < s; ++q)
+					{
+						const double swap = h[p*s + q];
+						h[p*s + q] = h[q*s + p];
+						h[q*s + p] = swap;
+					}
+			#endif
+
+			call_dgemm('n', 'n', n, k, s, 1.0, base, s_max, h, s, 0.0, x, k);
+			call_dgemm('n', 'n', n, k, s, 1.0, image, s_max, h, s, 0.0, ax, k);
+
+			for (size_t q = 0; q < k; ++q)
+				eigenval[q] = theta[q];
+
+			double max_residual = 0.0;
+			for (size_t q = 0; q < k; ++q)
+			{
+				double norm = 0.0;
+				for (size_t i = 0; i < n; ++i)
+				{
+					const double r = ax[i*k + q] - theta[q]*x[i*k + q];
+					norm += r*r;
+				}
+
+				if (sqrt(norm) > max_residual) max_residual = sqrt(norm);
+			}
+
+			if (max_residual < tol)
+			{
+				converged = true;
+				break;
+			}
+
+/*
+ *			Restart from the current Ritz vectors if the subspace is full:
+ */
+
+			if (s + k > s_max)
+			{
+				for (size_t i = 0; i < n; ++i)
+					for (size_t q = 0; q < k; ++q)
+					{
+						base[i*s_max + q] = x[i*k + q];
+						image[i*s_max + q] = ax[i*k + q];
+					}
+
+				s = k;
+			}
+
+/*
+ *			Expand the subspace with the preconditioned residuals r = m*x - theta*x,
+ *			t = P*r - e*P*x, where e = (x^T P r)/(x^T P x) is the Olsen correction:
+ */
+
+			const size_t s_old = s;
+
+			for (size_t q = 0; q < k; ++q)
+			{
+				double norm = 0.0;
+				for (size_t i = 0; i < n; ++i)
+				{
+					t[i] = ax[i*k + q] - theta[q]*x[i*k + q];
+					u[i] = x[i*k + q];
+					norm += t[i]*t[i];
+				}
+
+				if (sqrt(norm) < tol) continue;
+
+				precondition(m, ref, ref_eigenval, theta[q], t, work);
+				precondition(m, ref, ref_eigenval, theta[q], u, work);
+
+				double xpr = 0.0, xpx = 0.0;
+				for (size_t i = 0; i < n; ++i)
+				{
+					xpr += x[i*k + q]*t[i];
+					xpx += x[i*k + q]*u[i];
+				}
+
+				const double e = (xpx != 0.0? xpr/xpx : 0.0);
+
+				for (size_t i = 0; i < n; ++i)
+					t[i] -= e*u[i];
+
+				s = orthonormal_append(n, s, s_max, base, t);
+			}
+
+			if (s == s_old) break;
+
+			call_dgemm('n', 'n', n, s - s_old, n, 1.0, m->data, n,
+			           &base[s_old], s_max, 0.0, &image[s_old], s_max);
+		}
+
+		if (converged)
+		{
+			for (size_t i = 0; i < n; ++i)
+				for (size_t q = 0; q < k; ++q)
+					DATA_OFFSET(v, i, q) = x[i*k + q];
+		}
+
+		free(base);
+		free(image);
+		free(h);
+		free(theta);
+		free(x);
+		free(ax);
+		free(t);
+		free(u);
+		free(work);
+		free(seeded);
+	}
+
+	if (!converged)
+	{
+		matrix *copy = matrix_alloc_as(m, false);
+		matrix_copy(copy, m, 1.0, 0.0);
+
+		double *all = matrix_symm_eigen(copy, 'v');
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			for (size_t q = 0; q < k; ++q)
+			{
+				if (matrix_using_magma())
+					DATA_OFFSET(v, i, q) = DATA_OFFSET(copy, q, i);
+				else
+					DATA_OFFSET(v, i, q) = DATA_OFFSET(copy, i, q);
+			}
+		}
+
+		for (size_t q = 0; q < k; ++q)
+			eigenval[q] = all[q];
+
+		matrix_free(copy);
+		free(all);
+	}
+
+	return eigenval;
+}
+
 /******************************************************************************
 
  Function matrix_is_null(): return true if all elements are zero. Return false
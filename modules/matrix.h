@@ -4,6 +4,8 @@
 
 	typedef struct matrix matrix;
 
+	typedef struct matrix_pivot matrix_pivot;
+
 	struct tensor
 	{
 		matrix *value;
@@ -115,16 +117,47 @@
 	void matrix_multiply(const double alpha, const matrix *a,
 	                     const matrix *b, const double beta, matrix *c);
 
+	void matrix_multiply_trans(const double alpha,
+	                           const char trans_a,
+	                           const matrix *a,
+	                           const char trans_b,
+	                           const matrix *b,
+	                           const double beta,
+	                           matrix *c);
+
 	void matrix_add(const double alpha, const matrix *a,
 	                const double beta, const matrix *b, matrix *c);
 
 	void matrix_sub(const double alpha, const matrix *a,
 	                const double beta, const matrix *b, matrix *c);
 
+	matrix_pivot *matrix_pivot_alloc(const size_t max_row);
+
+	void matrix_pivot_free(matrix_pivot *pivot);
+
 	void matrix_inverse(matrix *m);
 
+	void matrix_inverse_pivot(matrix *m, matrix_pivot *pivot);
+
+	void matrix_solve(matrix *a, matrix *b, matrix_pivot *pivot);
+
+	void matrix_symm_solve(matrix *a, matrix *b, matrix_pivot *pivot);
+
+	void matrix_complex_solve(const size_t n,
+	                          const size_t n_rhs,
+	                          double complex a[],
+	                          double complex b[],
+	                          matrix_pivot *pivot);
+
 	double *matrix_symm_eigen(matrix *m, const char job);
 
+	double *matrix_symm_partial_eigen(const matrix *m,
+	                                  matrix *v,
+	                                  const matrix *ref,
+	                                  const double ref_eigenval[],
+	                                  const double tol,
+	                                  const size_t max_step);
+
 	bool matrix_is_null(const matrix *m);
 
 	bool matrix_is_positive(const matrix *m);
@@ -413,19 +413,19 @@ void mpi_send(const size_t to, const size_t n, const char type, void *data)
 			{
 				case 'i':
 					MPI_Send(data, n, MPI_INT, to, 667, MPI_COMM_WORLD);
-					return;
+					break;
 
 				case 'c':
 					MPI_Send(data, n, MPI_CHAR, to, 667, MPI_COMM_WORLD);
-					return;
+					break;
 
 				case 'f':
 					MPI_Send(data, n, MPI_FLOAT, to, 667, MPI_COMM_WORLD);
-					return;
+					break;
 
 				case 'd':
 					MPI_Send(data, n, MPI_DOUBLE, to, 667, MPI_COMM_WORLD);
-					return;
+					break;
 
 				default:
 					PRINT_ERROR("invalid type %c\n", type)
@@ -470,19 +470,19 @@ void mpi_receive(const size_t from, const size_t n, const char type, void *data)
 			{
 				case 'i':
 					MPI_Recv(data, m, MPI_INT, from, 667, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-					return;
+					break;
 
 				case 'c':
 					MPI_Recv(data, m, MPI_CHAR, from, 667, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-					return;
+					break;
 
 				case 'f':
 					MPI_Recv(data, m, MPI_FLOAT, from, 667, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-					return;
+					break;
 
 				case 'd':
 					MPI_Recv(data, m, MPI_DOUBLE, from, 667, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-					return;
+					break;
 
 				default:
 					PRINT_ERROR("invalid type %c\n", type)
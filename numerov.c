@@ -1,90 +1,716 @@
+#include <pthread.h>
+
 #include "modules/pes.h"
+#include "modules/fgh.h"
 #include "modules/file.h"
 #include "modules/matrix.h"
 #include "modules/mpi_lib.h"
+#include "modules/johnson.h"
 #include "modules/globals.h"
 
-#include "utils.h"
+#if !defined(COUPLING_MATRIX_FILE_FORMAT)
+	#define COUPLING_MATRIX_FILE_FORMAT "cmatrix_arrang=%c_n=%zu_J=%zu.bin"
+#endif
+
+#if !defined(COUPLING_DIAG_FILE_FORMAT)
+	#define COUPLING_DIAG_FILE_FORMAT "cdiag_arrang=%c_J=%zu.bin"
+#endif
+
+#if !defined(RATIO_MATRIX_FILE_FORMAT)
+	#define RATIO_MATRIX_FILE_FORMAT "%s/ratio_arrang=%c_E=%zu_J=%zu.bin"
+#endif
+
+#if !defined(RATIO_RADIUS_FILE_FORMAT)
+	#define RATIO_RADIUS_FILE_FORMAT "%s/ratio_R_arrang=%c_E=%zu_J=%zu.bin"
+#endif
+
+#if !defined(CHECKPOINT_FILE_FORMAT)
+	#define CHECKPOINT_FILE_FORMAT "%s/checkpoint_arrang=%c_E=%zu_J=%zu.bin"
+#endif
+
+#if !defined(S_MATRIX_FILE_FORMAT)
+	#define S_MATRIX_FILE_FORMAT "%s/smatrix_%s_arrang=%c_E=%zu_J=%zu.bin"
+#endif
 
-#define FORMAT "  %3d       %06f    %f\n"
+#define FORMAT "  %4zu    %4zu     %06f      %f\n"
 
 /******************************************************************************
 
- Function johnson_jcp78_numerov(): uses the method of B. R. Johnson, Ref. [1],
- to propagate the ratio matrix of a multichannel wavefunction from the radial
- grid point (n - 1) to n at a given total energy.
+ Function load_cmatrix(): read the coupling matrix from the disk for the n-th
+ grid point index, arrangement and total angular momentum J.
+
+******************************************************************************/
+
+inline static matrix *load_cmatrix(const char arrang, const size_t n, const size_t J)
+{
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, COUPLING_MATRIX_FILE_FORMAT, arrang, n, J);
+
+	return matrix_load(filename);
+}
+
+/******************************************************************************
 
- NOTE: the potential matrix is used as workspace and its content is destroyed
- if workspace = NULL.
+ Function save_ratio(): saves in the disk the ratio matrices of all max_energy
+ energies in the list, for a given arrangement and total angular momentum J.
+ Since energies converged earlier stop at their own radius, the grid point R[m]
+ of each ratio matrix is saved alongside, as a single double, and must be read
+ by any use of the ratio matrix, e.g. johnson_kmatrix().
 
 ******************************************************************************/
 
-void johnson_jcp78_numerov(const double grid_step,
-                           const double mass, const double tot_energy,
-                           matrix *pot_energy, matrix *ratio, matrix *workspace)
+void save_ratio(const char dir[],
+                const char arrang,
+                const size_t J,
+                const size_t max_energy,
+                const size_t list[],
+                const double R[],
+                matrix *ratio[])
 {
-	ASSERT(ratio != NULL)
-	ASSERT(pot_energy != NULL)
+	char filename[MAX_LINE_LENGTH];
+
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		sprintf(filename, RATIO_MATRIX_FILE_FORMAT, dir, arrang, list[m], J);
+		matrix_save(ratio[m], filename);
 
-	if (!matrix_null(ratio)) matrix_inverse(ratio);
+		sprintf(filename, RATIO_RADIUS_FILE_FORMAT, dir, arrang, list[m], J);
 
-/*
- *	NOTE: From Eq. (2) and (17) of Ref. [1] the following numerical
- *	factor is defined in atomic units:
- */
+		FILE *output = file_open(filename, "wb");
+		file_write(&R[m], sizeof(double), 1, output);
+		file_close(&output);
+	}
+}
+
+/******************************************************************************
 
-	const double factor = -grid_step*grid_step*2.0*mass/12.0;
+ Type checkpoint: a snapshot of the propagation of max_energy energies, taken
+ by checkpoint_save() and written in the disk by a background thread, so that
+ the propagation goes on while files are written. For each energy, next is the
+ index of the next grid point to propagate (zero if not started yet), done is
+ true if converged at R_end (see k_converged()) and copy is its ratio matrix.
 
-/*
- *	Resolve Eq. (23) of Ref. [1] with Eq. (2) and (17) plugged in:
- */
+******************************************************************************/
+
+struct checkpoint
+{
+	char arrang, *dir;
+	size_t J, max_energy, *next;
+	const size_t *list;
+	double R_step, *R_end;
+	const double *energy;
+	bool *done, busy;
+	matrix **copy;
+	pthread_t thread;
+};
+
+typedef struct checkpoint checkpoint;
+
+/******************************************************************************
+
+ Function checkpoint_alloc(): returns a checkpoint of max_energy energies, in
+ the list, with max_channel channels each, whose files are stored in dir for a
+ given arrangement, total angular momentum J and grid step, R_step.
+
+******************************************************************************/
+
+checkpoint *checkpoint_alloc(const char dir[],
+                             const char arrang,
+                             const size_t J,
+                             const double R_step,
+                             const size_t max_energy,
+                             const size_t list[],
+                             const double energy[],
+                             const size_t max_channel)
+{
+	checkpoint *c = allocate(1, sizeof(checkpoint), true);
+
+	c->dir = allocate(strlen(dir) + 1, sizeof(char), false);
+	strcpy(c->dir, dir);
+
+	c->arrang = arrang;
+	c->J = J;
+	c->R_step = R_step;
+	c->max_energy = max_energy;
+	c->list = list;
+	c->energy = energy;
+	c->busy = false;
+
+	c->next = allocate(max_energy, sizeof(size_t), true);
+	c->R_end = allocate(max_energy, sizeof(double), true);
+	c->done = allocate(max_energy, sizeof(bool), true);
+	c->copy = allocate(max_energy, sizeof(matrix *), false);
+
+	for (size_t m = 0; m < max_energy; ++m)
+		c->copy[m] = matrix_alloc(max_channel, max_channel, false);
+
+	return c;
+}
+
+/******************************************************************************
+
+ Function checkpoint_write(): the background thread of checkpoint_save(). Each
+ energy is written in a temporary file, then renamed, thus a run killed while
+ writing still leaves the previous checkpoint intact.
+
+******************************************************************************/
+
+static void *checkpoint_write(void *data)
+{
+	const checkpoint *c = data;
+
+	char filename[MAX_LINE_LENGTH], temp[MAX_LINE_LENGTH + 4];
+
+	for (size_t m = 0; m < c->max_energy; ++m)
+	{
+		sprintf(filename, CHECKPOINT_FILE_FORMAT, c->dir, c->arrang, c->list[m], c->J);
+		sprintf(temp, "%s.tmp", filename);
+
+		FILE *output = file_open(temp, "wb");
+
+		const size_t max_row = matrix_rows(c->copy[m]);
+		const size_t max_col = matrix_cols(c->copy[m]);
+
+		file_write(&c->next[m], sizeof(size_t), 1, output);
+		file_write(&c->done[m], sizeof(bool), 1, output);
+		file_write(&c->R_step, sizeof(double), 1, output);
+		file_write(&c->energy[m], sizeof(double), 1, output);
+		file_write(&c->R_end[m], sizeof(double), 1, output);
+		file_write(&max_row, sizeof(size_t), 1, output);
+		file_write(&max_col, sizeof(size_t), 1, output);
+
+		double *raw = matrix_data_raw(c->copy[m]);
+		file_write(raw, sizeof(double), max_row*max_col, output);
+		free(raw);
+
+		file_close(&output);
+
+		file_rename(temp, filename);
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+
+ Function checkpoint_wait(): blocks until the files of the last checkpoint, if
+ any, are written.
+
+******************************************************************************/
+
+void checkpoint_wait(checkpoint *c)
+{
+	if (!c->busy) return;
+
+	if (pthread_join(c->thread, NULL) != 0)
+	{
+		PRINT_ERROR("unable to join the checkpoint thread of J = %zu\n", c->J)
+		exit(EXIT_FAILURE);
+	}
+
+	c->busy = false;
+}
+
+/******************************************************************************
+
+ Function checkpoint_save(): takes a snapshot of the ratio matrices of all max_
+ energy energies, propagated up to the n-th grid point, and writes it in the
+ disk by a background thread. Energies that start after n (see wkb_start()) are
+ saved as not started.
+
+ NOTE: the thread of the previous checkpoint is waited first, thus at most one
+ snapshot is written at a time and the only blocking cost is the copy.
+
+******************************************************************************/
+
+void checkpoint_save(checkpoint *c,
+                     const size_t n,
+                     const size_t start[],
+                     const bool done[],
+                     const double R_end[],
+                     matrix *ratio[])
+{
+	checkpoint_wait(c);
+
+	for (size_t m = 0; m < c->max_energy; ++m)
+	{
+		matrix_copy(c->copy[m], ratio[m], 1.0, 0.0);
+
+		c->next[m] = (n + 1 > start[m]? n + 1 : 0);
+		c->done[m] = done[m];
+		c->R_end[m] = R_end[m];
+	}
+
+	if (pthread_create(&c->thread, NULL, checkpoint_write, c) != 0)
+	{
+		PRINT_ERROR("unable to start the checkpoint thread of J = %zu\n", c->J)
+		exit(EXIT_FAILURE);
+	}
+
+	c->busy = true;
+}
+
+/******************************************************************************
+
+ Function checkpoint_free(): waits for the last checkpoint, if any, and frees
+ the resources allocated by checkpoint_alloc().
+
+******************************************************************************/
 
-	matrix *w = NULL;
+void checkpoint_free(checkpoint *c)
+{
+	checkpoint_wait(c);
+
+	for (size_t m = 0; m < c->max_energy; ++m)
+		matrix_free(c->copy[m]);
+
+	free(c->copy);
+	free(c->done);
+	free(c->R_end);
+	free(c->next);
+	free(c->dir);
+	free(c);
+}
+
+/******************************************************************************
+
+ Function save_smatrix(): saves in the disk the real and imaginary parts of the
+ open-channel S matrices of all max_energy energies in the list, for a given
+ arrangement and total angular momentum J. Energies with no open channels are
+ skipped.
+
+******************************************************************************/
+
+void save_smatrix(const char dir[],
+                  const char arrang,
+                  const size_t J,
+                  const size_t max_energy,
+                  const size_t list[],
+                  smatrix *s[])
+{
+	char filename[MAX_LINE_LENGTH];
+
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		if (s[m] == NULL) continue;
+
+		sprintf(filename, S_MATRIX_FILE_FORMAT, dir, "re", arrang, list[m], J);
+		matrix_save(s[m]->re_part, filename);
+
+		sprintf(filename, S_MATRIX_FILE_FORMAT, dir, "im", arrang, list[m], J);
+		matrix_save(s[m]->im_part, filename);
+	}
+}
+
+/******************************************************************************
+
+ Function load_checkpoint(): loads from the disk the checkpoints, as saved by
+ checkpoint_save(), of all max_energy energies in the list. For each energy
+ found, its ratio matrix is restored and it resumes from the next grid point
+ saved, start[m], or keeps done[m] and R_end[m] if converged. Energies without
+ a checkpoint, or whose checkpoint is for another energy (e.g. the grid was
+ extended with a different step), are propagated from scratch. The number of
+ energies resumed is returned.
+
+ NOTE: the same grid step is required, but not the same R_max, thus a longer
+ scattering grid continues from the last point of a previous run.
 
-	if (workspace == NULL)
-		w = pot_energy;
-	else
-		w = workspace;
+******************************************************************************/
+
+size_t load_checkpoint(const char dir[],
+                       const char arrang,
+                       const size_t J,
+                       const double R_step,
+                       const size_t max_energy,
+                       const size_t list[],
+                       const double energy[],
+                       matrix *ratio[],
+                       size_t start[],
+                       bool done[],
+                       double R_end[])
+{
+	char filename[MAX_LINE_LENGTH];
 
-	const int n_max = matrix_row(pot_energy);
+	size_t counter = 0;
 
-	for (int n = 0; n < n_max; ++n)
+	for (size_t m = 0; m < max_energy; ++m)
 	{
-		const double t_nn = factor*(tot_energy - matrix_get(pot_energy, n, n));
+		sprintf(filename, CHECKPOINT_FILE_FORMAT, dir, arrang, list[m], J);
 
-		matrix_diag_set(w, n, 1.0 - t_nn);
+		if (!file_exist(filename)) continue;
 
-		for (int m = (n + 1); m < n_max; ++m)
+		FILE *input = file_open(filename, "rb");
+
+		size_t next = 0, max_row = 0, max_col = 0;
+		double step = 0.0, E = 0.0, R = 0.0;
+		bool converged = false;
+
+		file_read(&next, sizeof(size_t), 1, input, 0);
+		file_read(&converged, sizeof(bool), 1, input, 0);
+		file_read(&step, sizeof(double), 1, input, 0);
+		file_read(&E, sizeof(double), 1, input, 0);
+		file_read(&R, sizeof(double), 1, input, 0);
+		file_read(&max_row, sizeof(size_t), 1, input, 0);
+		file_read(&max_col, sizeof(size_t), 1, input, 0);
+
+		if (fabs(step - R_step) > 1.0E-10*R_step)
+		{
+			PRINT_ERROR("grid step of %s is %f, not %f\n", filename, step, R_step)
+			exit(EXIT_FAILURE);
+		}
+
+		if (max_row != matrix_rows(ratio[m]) || max_col != matrix_cols(ratio[m]))
 		{
-			const double t_nm = factor*(0.0 - matrix_get(pot_energy, n, m));
+			PRINT_ERROR("%s has %zu channels, not %zu\n", filename, max_row, matrix_rows(ratio[m]))
+			exit(EXIT_FAILURE);
+		}
 
-			matrix_symm_set(w, n, m, 0.0 - t_nm);
+		if (fabs(E - energy[m]) > 1.0E-10*fmax(1.0, fabs(energy[m])) || next == 0)
+		{
+			file_close(&input);
+			continue;
 		}
+
+		double *raw = allocate(max_row*max_col, sizeof(double), false);
+		file_read(raw, sizeof(double), max_row*max_col, input, 0);
+
+		for (size_t i = 0; i < max_row; ++i)
+			for (size_t j = 0; j < max_col; ++j)
+				matrix_set(ratio[m], i, j, raw[i*max_col + j]);
+
+		free(raw);
+		file_close(&input);
+
+		if (next > start[m]) start[m] = next;
+
+		if (converged)
+		{
+			done[m] = true;
+			R_end[m] = R;
+		}
+
+		++counter;
 	}
 
-/*
- *	Solve Eq. (22) and (24) of Ref. [1]:
- */
+	return counter;
+}
+
+/******************************************************************************
+
+ Function wkb_start(): sets, for each of the max_energy energies, the index of
+ the grid point from which it is propagated, see johnson_wkb_start(), given the
+ diagonal of all coupling matrices of the grid. The latter is read from the
+ single file saved by a+d_cmatrix, thus no coupling matrix is read twice.
+
+******************************************************************************/
+
+void wkb_start(const char arrang,
+               const size_t J,
+               const size_t grid_size,
+               const size_t max_channel,
+               const double R_step,
+               const double mass,
+               const double depth,
+               const size_t max_energy,
+               const double energy[],
+               size_t start[])
+{
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, COUPLING_DIAG_FILE_FORMAT, arrang, J);
+
+	if (!file_exist(filename))
+	{
+		PRINT_ERROR("%s not found, as needed by wkb_depth > 0\n", filename)
+		exit(EXIT_FAILURE);
+	}
+
+	FILE *input = file_open(filename, "rb");
+
+	size_t max_row = 0, max_ch = 0;
+
+	file_read(&max_row, sizeof(size_t), 1, input, 0);
+	file_read(&max_ch, sizeof(size_t), 1, input, 0);
+
+	if (max_row != grid_size || max_ch != max_channel)
+	{
+		PRINT_ERROR("%s has %zu grid points and %zu channels, not %zu and %zu\n",
+		            filename, max_row, max_ch, grid_size, max_channel)
+		exit(EXIT_FAILURE);
+	}
+
+	double *diag = allocate(grid_size*max_ch, sizeof(double), false);
+
+	file_read(diag, sizeof(double), grid_size*max_ch, input, 0);
+	file_close(&input);
+
+	for (size_t m = 0; m < max_energy; ++m)
+		start[m] = johnson_wkb_start(grid_size, max_ch, R_step, mass, energy[m], depth, diag);
+
+	free(diag);
+}
+
+/******************************************************************************
+
+ Function k_converged(): returns true if the open-open block of the K matrix k
+ differs from the one of k_old by less than tol in all elements, measured by the
+ chordal distance |a - b|/sqrt[(1 + a^2)(1 + b^2)], which is bounded for large
+ elements (e.g. near a resonance).
+
+******************************************************************************/
+
+bool k_converged(const matrix *k_old,
+                 const matrix *k,
+                 const double level[],
+                 const double energy,
+                 const double tol)
+{
+	const size_t max_ch = matrix_rows(k);
+
+	for (size_t i = 0; i < max_ch; ++i)
+	{
+		if (level[i] > energy) continue;
+
+		for (size_t j = 0; j < max_ch; ++j)
+		{
+			if (level[j] > energy) continue;
+
+			const double a = matrix_get(k_old, i, j);
+			const double b = matrix_get(k, i, j);
+
+			if (fabs(a - b)/sqrt((1.0 + a*a)*(1.0 + b*b)) > tol) return false;
+		}
+	}
+
+	return true;
+}
+
+/******************************************************************************
+
+ Function driver(): propagates one grid step the ratio matrices of all max_energy
+ total energies, at a fixed R whose coupling matrix is pot_energy. The wall time
+ in seconds is returned.
+
+ NOTE: pot_energy is read-only, thus it is loaded only once for all energies,
+ and also diagonalized only once if there are enough of them, see johnson_jcp78_
+ multi_numerov().
+
+******************************************************************************/
+
+double driver(const double R_step,
+              const double mass,
+              const size_t max_energy,
+              const double energy[],
+              const matrix *pot_energy,
+              matrix *ratio[],
+              matrix *eigenvec,
+              johnson_workspace *work[],
+              const bool use_omp)
+{
+	const double start_time = wall_time();
+
+	johnson_jcp78_multi_numerov(R_step, mass, max_energy, energy,
+	                            pot_energy, ratio, eigenvec, work, use_omp);
+
+	const double end_time = wall_time();
+
+	return (end_time - start_time);
+}
+
+/******************************************************************************
+
+ Type omega_block: the max_ch channels of a given helicity omega in the coupled-
+ states (CS) approximation, whose indices in the full basis are index[], with
+ the respective ratio matrices of all energies and own workspace. Since omega is
+ conserved, each block is propagated independently, see cs_driver().
+
+******************************************************************************/
+
+struct omega_block
+{
+	size_t omega, max_ch, *index;
+	matrix *pot_energy, *eigenvec, **ratio, **active;
+	johnson_workspace *work;
+};
+
+/******************************************************************************
+
+ Function cs_blocks(): returns the list of omega blocks, with their number in
+ max_block, for max_channel channels of helicities omega[] and max_energy
+ energies. The ratio matrices are initialized as zero.
+
+******************************************************************************/
+
+struct omega_block *cs_blocks(const size_t max_channel,
+                              const size_t omega[],
+                              const size_t max_energy,
+                              size_t *max_block)
+{
+	size_t omega_max = 0;
+
+	for (size_t n = 0; n < max_channel; ++n)
+		if (omega[n] > omega_max) omega_max = omega[n];
+
+	struct omega_block *block
+		= allocate(omega_max + 1, sizeof(struct omega_block), true);
 
-	matrix_inverse(w);
+	*max_block = 0;
 
-	for (int n = 0; n < n_max; ++n)
+	for (size_t k = 0; k <= omega_max; ++k)
 	{
-		const double u_nn = 12.0*matrix_get(w, n, n) - 10.0;
+		struct omega_block *b = &block[*max_block];
+
+		for (size_t n = 0; n < max_channel; ++n)
+			if (omega[n] == k) ++b->max_ch;
+
+		if (b->max_ch == 0) continue;
+
+		b->omega = k;
+		b->index = allocate(b->max_ch, sizeof(size_t), false);
+
+		size_t counter = 0;
+		for (size_t n = 0; n < max_channel; ++n)
+			if (omega[n] == k) b->index[counter++] = n;
+
+		b->pot_energy = matrix_alloc(b->max_ch, b->max_ch, false);
+		b->eigenvec = matrix_alloc(b->max_ch, b->max_ch, false);
+		b->ratio = allocate(max_energy, sizeof(matrix *), false);
+		b->active = allocate(max_energy, sizeof(matrix *), false);
+		b->work = johnson_workspace_alloc(b->max_ch);
+
+		for (size_t m = 0; m < max_energy; ++m)
+			b->ratio[m] = matrix_alloc(b->max_ch, b->max_ch, true);
+
+		*max_block += 1;
+	}
+
+	return block;
+}
+
+/******************************************************************************
+
+ Function cs_blocks_free(): frees the resources of max_block blocks as returned
+ by cs_blocks().
+
+******************************************************************************/
+
+void cs_blocks_free(const size_t max_block,
+                    const size_t max_energy, struct omega_block block[])
+{
+	for (size_t k = 0; k < max_block; ++k)
+	{
+		for (size_t m = 0; m < max_energy; ++m)
+			matrix_free(block[k].ratio[m]);
+
+		johnson_workspace_free(block[k].work);
+		matrix_free(block[k].pot_energy);
+		matrix_free(block[k].eigenvec);
+
+		free(block[k].active);
+		free(block[k].ratio);
+		free(block[k].index);
+	}
+
+	free(block);
+}
+
+/******************************************************************************
+
+ Function cs_gather(): sets the full (block diagonal) ratio matrices of all max_
+ energy energies from the ones of each block.
+
+******************************************************************************/
+
+void cs_gather(const size_t max_block,
+               const struct omega_block block[],
+               const size_t max_energy,
+               matrix *ratio[])
+{
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		matrix_set_zero(ratio[m]);
+
+		for (size_t k = 0; k < max_block; ++k)
+		{
+			const struct omega_block *b = &block[k];
+
+			for (size_t i = 0; i < b->max_ch; ++i)
+				for (size_t j = 0; j < b->max_ch; ++j)
+					matrix_set(ratio[m], b->index[i], b->index[j], matrix_get(b->ratio[m], i, j));
+		}
+	}
+}
+
+/******************************************************************************
+
+ Function cs_scatter(): the inverse of cs_gather(), e.g. after a restart.
 
-		matrix_diag_set(ratio, n, u_nn - matrix_get(ratio, n, n));
+******************************************************************************/
 
-		for (int m = (n + 1); m < n_max; ++m)
+void cs_scatter(const size_t max_block,
+                struct omega_block block[],
+                const size_t max_energy,
+                matrix *ratio[])
+{
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		for (size_t k = 0; k < max_block; ++k)
 		{
-			const double u_nm = 12.0*matrix_get(w, n, m);
+			struct omega_block *b = &block[k];
 
-			matrix_symm_set(ratio, n, m, u_nm - matrix_get(ratio, n, m));
+			for (size_t i = 0; i < b->max_ch; ++i)
+				for (size_t j = 0; j < b->max_ch; ++j)
+					matrix_set(b->ratio[m], i, j, matrix_get(ratio[m], b->index[i], b->index[j]));
 		}
 	}
+}
+
+/******************************************************************************
+
+ Function cs_driver(): the same as driver() but for the coupled-states blocks,
+ where only the max_active energies of indices active[] are propagated. Blocks
+ are shared among OpenMP threads, each one diagonalizing the coupling matrix of
+ its blocks only.
+
+******************************************************************************/
+
+double cs_driver(const double R_step,
+                 const double mass,
+                 const size_t max_active,
+                 const size_t active[],
+                 const double active_energy[],
+                 const matrix *pot_energy,
+                 const size_t max_block,
+                 struct omega_block block[],
+                 const bool use_omp)
+{
+	const double start_time = wall_time();
+
+	const bool use_threads = (use_omp && !matrix_using_magma());
+
+	#pragma omp parallel for default(none) shared(active, active_energy, pot_energy, block) firstprivate(R_step, mass, max_active, max_block) schedule(dynamic) if(use_threads)
+	for (size_t k = 0; k < max_block; ++k)
+	{
+		struct omega_block *b = &block[k];
+
+		for (size_t i = 0; i < b->max_ch; ++i)
+			for (size_t j = 0; j < b->max_ch; ++j)
+				matrix_set(b->pot_energy, i, j, matrix_get(pot_energy, b->index[i], b->index[j]));
+
+		for (size_t m = 0; m < max_active; ++m)
+			b->active[m] = b->ratio[active[m]];
 
-	w = NULL;
+		johnson_jcp78_multi_numerov(R_step, mass, max_active, active_energy,
+		                            b->pot_energy, b->active, b->eigenvec, &b->work, false);
+	}
+
+	const double end_time = wall_time();
+
+	return (end_time - start_time);
 }
 
+/******************************************************************************
+******************************************************************************/
+
 int main(int argc, char *argv[])
 {
 	mpi_init(argc, argv);
@@ -95,7 +721,7 @@ int main(int argc, char *argv[])
  *	Arrangement (a = 1, b = 2, c = 3) and atomic masses:
  */
 
-	const char arrang = 96 + (int) file_keyword(stdin, "arrang", 1.0, 3.0, 1.0);
+	const char arrang = 96 + read_int_keyword(stdin, "arrang", 1, 3, 1);
 
 	pes_init_mass(stdin, 'a');
 	pes_init_mass(stdin, 'b');
@@ -107,87 +733,332 @@ int main(int argc, char *argv[])
  *	Total angular momentum, J:
  */
 
-	const int J = (int) file_keyword(stdin, "J", 0.0, INF, 0.0);
+	const size_t J = read_int_keyword(stdin, "J", 0, 10000, 0);
 
 /*
- *	Collision energy grid:
+ *	Total energy grid:
  */
 
-	const int coll_grid_size = (int) file_keyword(stdin, "coll_grid_size", 1.0, INF, 100.0);
+	const size_t coll_grid_size = read_int_keyword(stdin, "coll_grid_size", 1, 1000000, 100);
 
-	const double E_min = file_keyword(stdin, "E_min", -INF, INF, 0.0);
+	const double E_min = read_dbl_keyword(stdin, "E_min", -INF, INF, 0.0);
 
-	const double E_max = file_keyword(stdin, "E_max", E_min, INF, E_min);
+	const double E_max = read_dbl_keyword(stdin, "E_max", E_min, INF, E_min);
 
 	const double E_step = (E_max - E_min)/as_double(coll_grid_size);
 
 /*
- *	Scattering grid:
+ *	Scattering grid (the same used for multipoles and coupling matrices):
  */
 
-	const int scatt_grid_size = (int) file_keyword(stdin, "scatt_grid_size", 1.0, INF, 500.0);
+	const size_t scatt_grid_size = read_int_keyword(stdin, "scatt_grid_size", 1, 1000000, 500);
 
-	const double R_min = file_keyword(stdin, "R_min", 0.0, INF, 0.5);
+	const double R_min = read_dbl_keyword(stdin, "R_min", 0.0, INF, 0.5);
 
-	const double R_max = file_keyword(stdin, "R_max", R_min, INF, R_min + 30.0);
+	const double R_max = read_dbl_keyword(stdin, "R_max", R_min, INF, R_min + 30.0);
 
 	const double R_step = (R_max - R_min)/as_double(scatt_grid_size);
 
 /*
- *	MPI:
+ *	Directories to read the basis functions from and to store ratio matrices. If
+ *	checkpoint_step > 0, a checkpoint of each energy is written in the background
+ *	every checkpoint_step grid points, and after the last one. If restart = 1,
+ *	each energy resumes from its checkpoint, if any, see load_checkpoint(). The
+ *	same R_step is required, thus R_max and scatt_grid_size may be raised alike
+ *	to extend a previous run, as may E_max and coll_grid_size (same E_step):
+ */
+
+	char *b_dir = read_str_keyword(stdin, "basis_dir", ".");
+
+	char *r_dir = read_str_keyword(stdin, "ratio_dir", ".");
+
+	const size_t checkpoint_step = read_int_keyword(stdin, "checkpoint_step", 0, scatt_grid_size, 0);
+
+	const bool restart = (bool) read_int_keyword(stdin, "restart", 0, 1, 0);
+
+/*
+ *	If wkb_depth > 0, each energy is propagated from its own grid point, deep
+ *	enough in the classically forbidden region of all channels that neglecting
+ *	the wavefunction before it costs about exp(-wkb_depth), e.g. 20, see wkb_
+ *	start(), which needs the diagonal file saved by a+d_cmatrix (cmatrix_stride
+ *	= 1). Otherwise, all energies start at R_min:
+ */
+
+	const double wkb_depth = read_dbl_keyword(stdin, "wkb_depth", 0.0, INF, 0.0);
+
+/*
+ *	If conv_step > 0, from conv_R on, the K matrix of each energy is matched
+ *	every conv_step grid points and, once the open-channel block changes by less
+ *	than conv_tol between two matchings, see k_converged(), the energy is not
+ *	propagated any further. The radius actually used is printed for each one and
+ *	saved with its ratio matrix, see save_ratio():
+ */
+
+	const size_t conv_step = read_int_keyword(stdin, "conv_step", 0, scatt_grid_size, 0);
+
+	const double conv_R = read_dbl_keyword(stdin, "conv_R", R_min, R_max, R_min);
+
+	const double conv_tol = read_dbl_keyword(stdin, "conv_tol", 0.0, 1.0, 1.0E-4);
+
+/*
+ *	If save_smatrix = 1, the S matrices of the open channels are also computed
+ *	and saved in ratio_dir, from the ratio matrices at the last grid point (or
+ *	at the radius of convergence):
+ */
+
+	const bool smatrix_output = (bool) read_int_keyword(stdin, "save_smatrix", 0, 1, 0);
+
+/*
+ *	Coupled-states approximation (the basis and coupling matrices must be built
+ *	likewise): each block of channels of same helicity, omega, is propagated on
+ *	its own, see cs_driver(). Ratio matrices are saved as block diagonal:
+ */
+
+	const bool coupled_states = (bool) read_int_keyword(stdin, "coupled_states", 0, 1, 0);
+
+/*
+ *	OpenMP: energies of each MPI process are propagated in parallel by threads,
+ *	each one with its own workspace, sharing the same coupling matrix.
+ */
+
+	const bool use_omp = (bool) read_int_keyword(stdin, "use_omp", 0, 1, 0);
+
+/*
+ *	Number of channels from the basis dir.:
+ */
+
+	const size_t max_channel = fgh_basis_count(b_dir, arrang, J);
+
+	ASSERT(max_channel > 0)
+
+/*
+ *	Asymptotic energy and angular momentum of each channel, from the basis:
+ */
+
+	int *l = allocate(max_channel, sizeof(int), false);
+	size_t *omega = allocate(max_channel, sizeof(size_t), false);
+	double *level = allocate(max_channel, sizeof(double), false);
+
+	fgh_basis_channels(b_dir, arrang, J, max_channel, l, omega, level);
+
+/*
+ *	MPI: each process keeps in memory the ratio matrices of its own energies,
+ *	including the extra one, if any, along the whole propagation.
  */
 
 	mpi_set_tasks(coll_grid_size);
 
+	size_t max_energy = mpi_last_task() - mpi_first_task() + 1;
+
+	if (mpi_extra_task() > 0) ++max_energy;
+
+	size_t *list = allocate(max_energy, sizeof(size_t), false);
+	double *energy = allocate(max_energy, sizeof(double), false);
+	matrix **ratio = allocate(max_energy, sizeof(matrix *), false);
+
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		list[m] = (m + mpi_first_task() <= mpi_last_task()? m + mpi_first_task() : mpi_extra_task());
+
+		energy[m] = E_min + as_double(list[m])*E_step;
+
+		ratio[m] = matrix_alloc(max_channel, max_channel, true);
+	}
+
+	size_t *start = allocate(max_energy, sizeof(size_t), true);
+
+	bool *done = allocate(max_energy, sizeof(bool), true);
+	double *R_end = allocate(max_energy, sizeof(double), false);
+	matrix **k_last = allocate(max_energy, sizeof(matrix *), true);
+
+	for (size_t m = 0; m < max_energy; ++m)
+		R_end[m] = R_min + as_double(scatt_grid_size - 1)*R_step;
+
+	if (wkb_depth > 0.0)
+		wkb_start(arrang, J, scatt_grid_size, max_channel, R_step, mass, wkb_depth, max_energy, energy, start);
+
+/*
+ *	NOTE: energies are resumed after wkb_start(), since a checkpoint is always
+ *	beyond the starting point of its energy.
+ */
+
+	if (restart)
+	{
+		const size_t counter = load_checkpoint(r_dir, arrang, J, R_step,
+		                                       max_energy, list, energy, ratio, start, done, R_end);
+
+		printf("# CPU %zu: %zu of %zu energies resumed from checkpoints\n", mpi_rank(), counter, max_energy);
+	}
+
+	checkpoint *chk = (checkpoint_step > 0?
+		checkpoint_alloc(r_dir, arrang, J, R_step, max_energy, list, energy, max_channel) : NULL);
+
+	size_t max_block = 0;
+	struct omega_block *block = NULL;
+
+	if (coupled_states)
+	{
+		block = cs_blocks(max_channel, omega, max_energy, &max_block);
+
+		if (restart) cs_scatter(max_block, block, max_energy, ratio);
+	}
+
 /*
  *	Resolve all tasks:
  */
 
 	if (mpi_rank() == 0)
 	{
-		printf("# MPI CPUs = %d, OpenMP threads = %d, num. of energies = %d\n", mpi_comm_size(), max_threads(), coll_grid_size);
-		printf("# CPU    R (a.u.)    wall time (s)\n");
-		printf("# --------------------------------\n");
+		printf("# MPI CPUs = %zu, OpenMP threads = %d, num. of energies = %zu, num. of channels = %zu\n",
+		       mpi_comm_size(), max_threads(), coll_grid_size, max_channel);
+
+		if (coupled_states) printf("# Coupled states: %zu omega blocks\n", max_block);
+
+		printf("#  CPU       n     R (a.u.)     wall time (s)\n");
+		printf("# ------------------------------------------\n");
 	}
 
-	matrix *pot_energy = NULL, *ratio = NULL, *workspace = NULL;
+	matrix *eigenvec = matrix_alloc(max_channel, max_channel, false);
 
-	for (int n = 0; n < scatt_grid_size; ++n)
-	{
-		pot_energy = coupling_read(arrang, n, J, false);
+	const size_t max_workspace = (use_omp? (size_t) max_threads() : 1);
 
-		if (n == 0) workspace = matrix_alloc_as(pot_energy, false);
+	johnson_workspace **work = johnson_workspace_list(max_workspace, max_channel);
+
+	size_t *active = allocate(max_energy, sizeof(size_t), false);
+	double *active_energy = allocate(max_energy, sizeof(double), false);
+	matrix **active_ratio = allocate(max_energy, sizeof(matrix *), false);
+
+	for (size_t n = 0; n < scatt_grid_size; ++n)
+	{
+/*
+ *		NOTE: energies not yet started keep a null ratio matrix.
+ */
 
-		const double start_time = wall_time();
+		size_t max_active = 0;
 
-		for (int m = mpi_first_task(); m <= mpi_last_task(); ++m)
+		for (size_t m = 0; m < max_energy; ++m)
 		{
-			extra_step:
-			ratio = ratio_read(arrang, m, J, false);
+			if (n < start[m] || done[m]) continue;
+
+			active[max_active] = m;
+			active_energy[max_active] = energy[m];
+			active_ratio[max_active] = ratio[m];
+			++max_active;
+		}
+
+		if (max_active == 0) continue;
+
+		matrix *pot_energy = load_cmatrix(arrang, n, J);
 
-			const double tot_energy = E_min + as_double(m)*E_step;
+		ASSERT(matrix_rows(pot_energy) == max_channel)
 
-			johnson_jcp78_numerov(R_step, mass,
-			                      tot_energy, pot_energy, ratio, workspace);
+		const double wtime = (coupled_states?
+			cs_driver(R_step, mass, max_active, active, active_energy, pot_energy, max_block, block, use_omp) :
+			driver(R_step, mass, max_active, active_energy, pot_energy, active_ratio, eigenvec, work, use_omp));
 
-			ratio_write(arrang, m, J, false, ratio);
-			matrix_free(ratio);
+		if (mpi_rank() == 0) printf(FORMAT, mpi_rank(), n, R_min + as_double(n)*R_step, wtime);
 
-			if (m == mpi_last_task() && mpi_extra_task() > 0)
+		matrix_free(pot_energy);
+
+		const double R = R_min + as_double(n)*R_step;
+
+		const bool conv_check = (conv_step > 0 && R >= conv_R && (n + 1)%conv_step == 0);
+
+		const bool checkpoint = (checkpoint_step > 0 && (n + 1)%checkpoint_step == 0 && n + 1 < scatt_grid_size);
+
+		if (coupled_states && (conv_check || checkpoint))
+			cs_gather(max_block, block, max_energy, ratio);
+
+		if (conv_check)
+		{
+			for (size_t m = 0; m < max_energy; ++m)
 			{
-				m = mpi_extra_task();
-				goto extra_step;
+				if (n < start[m] || done[m]) continue;
+
+				matrix *k = johnson_kmatrix(l, R_step, energy[m], mass, level, ratio[m], R, work[0]);
+
+				if (k_last[m] != NULL && k_converged(k_last[m], k, level, energy[m], conv_tol))
+				{
+					done[m] = true;
+					R_end[m] = R;
+
+					printf("# CPU %zu: energy %zu converged at R = %f\n", mpi_rank(), list[m], R);
+				}
+
+				if (k_last[m] != NULL) matrix_free(k_last[m]);
+				k_last[m] = k;
 			}
 		}
 
-		const double end_time = wall_time(), R = R_min + as_double(n)*R_step;
+		if (checkpoint) checkpoint_save(chk, n, start, done, R_end, ratio);
+	}
 
-		if (mpi_rank() == 0) printf(FORMAT, mpi_rank(), R, end_time - start_time);
+/*
+ *	NOTE: only the ratio matrices at the last grid point, R_max - R_step, are
+ *	saved, while the last checkpoint is written in the background. Energies
+ *	converged earlier (conv_step > 0) keep the ratio matrix of the radius
+ *	R_end saved with it, see save_ratio().
+ */
 
-		matrix_free(pot_energy);
+	if (coupled_states)
+	{
+		cs_gather(max_block, block, max_energy, ratio);
+		cs_blocks_free(max_block, max_energy, block);
 	}
 
-	matrix_free(workspace);
+
+	save_ratio(r_dir, arrang, J, max_energy, list, R_end, ratio);
+
+	if (chk != NULL) checkpoint_save(chk, scatt_grid_size - 1, start, done, R_end, ratio);
+
+	if (smatrix_output)
+	{
+		smatrix **s = allocate(max_energy, sizeof(smatrix *), false);
+
+		johnson_multi_smatrix(l, R_step, max_energy, energy, mass, level, ratio, R_end, s, work, use_omp);
+
+		save_smatrix(r_dir, arrang, J, max_energy, list, s);
+
+		for (size_t m = 0; m < max_energy; ++m)
+		{
+			if (s[m] == NULL) continue;
+
+			matrix_free(s[m]->re_part);
+			matrix_free(s[m]->im_part);
+			free(s[m]);
+		}
+
+		free(s);
+	}
+
+	if (chk != NULL) checkpoint_free(chk);
+
+	for (size_t m = 0; m < max_energy; ++m)
+		matrix_free(ratio[m]);
+
+	johnson_workspace_list_free(max_workspace, work);
+
+	matrix_free(eigenvec);
+
+	for (size_t m = 0; m < max_energy; ++m)
+		if (k_last[m] != NULL) matrix_free(k_last[m]);
+
+	free(active_ratio);
+	free(active_energy);
+	free(active);
+	free(k_last);
+	free(R_end);
+	free(done);
+	free(start);
+
+	free(ratio);
+	free(energy);
+	free(list);
+	free(level);
+	free(omega);
+	free(l);
+	free(r_dir);
+	free(b_dir);
 
 	mpi_end();
 	return EXIT_SUCCESS;
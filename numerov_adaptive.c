@@ -0,0 +1,726 @@
+#include "modules/pes.h"
+#include "modules/fgh.h"
+#include "modules/file.h"
+#include "modules/matrix.h"
+#include "modules/mpi_lib.h"
+#include "modules/johnson.h"
+#include "modules/globals.h"
+
+#if !defined(COUPLING_MATRIX_FILE_FORMAT)
+	#define COUPLING_MATRIX_FILE_FORMAT "cmatrix_arrang=%c_n=%zu_J=%zu.bin"
+#endif
+
+#if !defined(ENERGY_K_MATRIX_FILE_FORMAT)
+	#define ENERGY_K_MATRIX_FILE_FORMAT "%s/kmatrix_arrang=%c_energy=%.15e_J=%zu.bin"
+#endif
+
+#if !defined(S_MATRIX_FILE_FORMAT)
+	#define S_MATRIX_FILE_FORMAT "%s/smatrix_%s_arrang=%c_E=%zu_J=%zu.bin"
+#endif
+
+#if !defined(ENERGY_LIST_FILE_FORMAT)
+	#define ENERGY_LIST_FILE_FORMAT "%s/energies_arrang=%c_J=%zu.dat"
+#endif
+
+#define FORMAT "# round %3zu: %6zu new energies, %6zu in total, max. error = % -8e, max. change of cross sections = % -8e, wall time = %f s\n"
+
+/******************************************************************************
+
+ Function load_cmatrix(): read the coupling matrix from the disk for the n-th
+ grid point index, arrangement and total angular momentum J.
+
+******************************************************************************/
+
+inline static matrix *load_cmatrix(const char arrang, const size_t n, const size_t J)
+{
+	char filename[MAX_LINE_LENGTH];
+	sprintf(filename, COUPLING_MATRIX_FILE_FORMAT, arrang, n, J);
+
+	return matrix_load(filename);
+}
+
+/******************************************************************************
+
+ Type point: one total energy E of the adaptive grid, whose K matrix is saved
+ as ENERGY_K_MATRIX_FILE_FORMAT, see propagate(), and s is the respective S
+ matrix of the open channels (null if none), with phase the sum of eigenphases
+ of K, see eigenphase_sum(). If refine is true, the interval from E to the next
+ energy of the grid is bisected in the next round.
+
+******************************************************************************/
+
+struct point
+{
+	double E, phase;
+	bool refine;
+	matrix *k;
+	smatrix *s;
+};
+
+/******************************************************************************
+
+ Function propagate(): computes, by the Numerov method from R_min to R_max, the
+ K matrices of max_energy total energies. Energies are dealt among MPI processes
+ in a round-robin fashion, each one saving its own K matrices in k_dir, which
+ are then loaded by all processes into k[].
+
+ NOTE: k_dir must be visible to all processes, as the coupling matrices. Since
+ the energies are not on a uniform grid, the K matrix files are named by the
+ energy itself, not by the index of K_MATRIX_FILE_FORMAT used by other drivers.
+
+******************************************************************************/
+
+void propagate(const char arrang,
+               const size_t J,
+               const size_t grid_size,
+               const double R_min,
+               const double R_step,
+               const double mass,
+               const size_t max_channel,
+               const int l[],
+               const double level[],
+               const size_t max_energy,
+               const double energy[],
+               const char k_dir[],
+               matrix *k[],
+               const bool use_omp)
+{
+	char filename[MAX_LINE_LENGTH];
+
+	size_t max_local = 0;
+	for (size_t m = mpi_rank(); m < max_energy; m += mpi_comm_size())
+		++max_local;
+
+	if (max_local > 0)
+	{
+		double *local_energy = allocate(max_local, sizeof(double), false);
+		matrix **ratio = allocate(max_local, sizeof(matrix *), false);
+		matrix **local_k = allocate(max_local, sizeof(matrix *), false);
+
+		size_t counter = 0;
+		for (size_t m = mpi_rank(); m < max_energy; m += mpi_comm_size())
+		{
+			local_energy[counter] = energy[m];
+			ratio[counter] = matrix_alloc(max_channel, max_channel, true);
+			++counter;
+		}
+
+		const size_t max_workspace = (use_omp? (size_t) max_threads() : 1);
+
+		johnson_workspace **work = johnson_workspace_list(max_workspace, max_channel);
+
+		matrix *eigenvec = matrix_alloc(max_channel, max_channel, false);
+
+		for (size_t n = 0; n < grid_size; ++n)
+		{
+			matrix *pot_energy = load_cmatrix(arrang, n, J);
+
+			ASSERT(matrix_rows(pot_energy) == max_channel)
+
+			johnson_jcp78_multi_numerov(R_step, mass, max_local, local_energy,
+			                            pot_energy, ratio, eigenvec, work, use_omp);
+
+			matrix_free(pot_energy);
+		}
+
+		const double R = R_min + as_double(grid_size - 1)*R_step;
+
+		johnson_multi_kmatrix(l, R_step, max_local, local_energy,
+		                      mass, level, ratio, R, local_k, work, use_omp);
+
+		for (size_t m = 0; m < max_local; ++m)
+		{
+			sprintf(filename, ENERGY_K_MATRIX_FILE_FORMAT, k_dir, arrang, local_energy[m], J);
+			matrix_save(local_k[m], filename);
+
+			matrix_free(local_k[m]);
+			matrix_free(ratio[m]);
+		}
+
+		johnson_workspace_list_free(max_workspace, work);
+
+		matrix_free(eigenvec);
+
+		free(local_k);
+		free(ratio);
+		free(local_energy);
+	}
+
+	mpi_barrier();
+
+	for (size_t m = 0; m < max_energy; ++m)
+	{
+		sprintf(filename, ENERGY_K_MATRIX_FILE_FORMAT, k_dir, arrang, energy[m], J);
+		k[m] = matrix_load(filename);
+	}
+}
+
+/******************************************************************************
+
+ Function eigenphase_sum(): returns the sum of arctan of the eigenvalues of the
+ open-open block of a K matrix, for a total energy E.
+
+ NOTE: the sum is defined modulo pi, as eigenvalues of K cross its poles.
+
+******************************************************************************/
+
+double eigenphase_sum(const matrix *k, const double level[], const double E)
+{
+	const size_t max_ch = matrix_rows(k);
+
+	size_t max_open = 0;
+	for (size_t n = 0; n < max_ch; ++n)
+		if (level[n] < E) ++max_open;
+
+	if (max_open == 0) return 0.0;
+
+	matrix *open = matrix_alloc(max_open, max_open, false);
+
+	size_t p = 0;
+	for (size_t n = 0; n < max_ch; ++n)
+	{
+		if (level[n] >= E) continue;
+
+		size_t q = 0;
+		for (size_t m = 0; m < max_ch; ++m)
+		{
+			if (level[m] >= E) continue;
+
+			matrix_set(open, p, q, matrix_get(k, n, m));
+			++q;
+		}
+
+		++p;
+	}
+
+	double *eigenval = matrix_symm_eigen(open, 'n');
+
+	double result = 0.0;
+	for (size_t n = 0; n < max_open; ++n)
+		result += atan(eigenval[n]);
+
+	free(eigenval);
+	matrix_free(open);
+
+	return result;
+}
+
+/******************************************************************************
+
+ Function phase_change(): returns the change of the sum of eigenphases from the
+ point a to b, folded into [0, pi/2] since each sum is defined modulo pi.
+
+******************************************************************************/
+
+inline static double phase_change(const struct point *a, const struct point *b)
+{
+	const double delta = b->phase - a->phase;
+
+	return fabs(delta - M_PI*round(delta/M_PI));
+}
+
+/******************************************************************************
+
+ Function interp_error(): returns the largest deviation |S - S_mid| between the
+ S matrix s_mid, computed at E, and the linear interpolation S of s_a and s_b
+ (at E_a < E < E_b). It returns INF if a threshold lies in [E_a, E_b], where S
+ is not smooth.
+
+******************************************************************************/
+
+double interp_error(const smatrix *s_a,
+                    const smatrix *s_mid,
+                    const smatrix *s_b,
+                    const double E_a,
+                    const double E,
+                    const double E_b)
+{
+	if (s_a == NULL || s_mid == NULL || s_b == NULL)
+		return (s_a == s_b && s_a == s_mid? 0.0 : INF);
+
+	const size_t max_open = matrix_rows(s_mid->re_part);
+
+	if (matrix_rows(s_a->re_part) != max_open) return INF;
+	if (matrix_rows(s_b->re_part) != max_open) return INF;
+
+	const double t = (E - E_a)/(E_b - E_a);
+
+	double result = 0.0;
+
+	for (size_t n = 0; n < max_open; ++n)
+	{
+		for (size_t m = 0; m < max_open; ++m)
+		{
+			const double re = (1.0 - t)*matrix_get(s_a->re_part, n, m)
+			                + t*matrix_get(s_b->re_part, n, m) - matrix_get(s_mid->re_part, n, m);
+
+			const double im = (1.0 - t)*matrix_get(s_a->im_part, n, m)
+			                + t*matrix_get(s_b->im_part, n, m) - matrix_get(s_mid->im_part, n, m);
+
+			const double error = sqrt(re*re + im*im);
+
+			if (error > result) result = error;
+		}
+	}
+
+	return result;
+}
+
+/******************************************************************************
+
+ Function interp_smatrix(): returns the S matrix at E by linear interpolation
+ between the two energies of the grid p (ascending) around it, or NULL if no
+ channel is open. If a threshold lies between them, the one with the same open
+ channels of E is used instead, or the nearest.
+
+******************************************************************************/
+
+smatrix *interp_smatrix(const size_t max_point,
+                        const struct point p[],
+                        const size_t max_open,
+                        const double E)
+{
+	if (max_open == 0) return NULL;
+
+	size_t a = 0;
+	while (a + 2 < max_point && p[a + 1].E <= E)
+		++a;
+
+	const smatrix *s_a = p[a].s, *s_b = p[a + 1].s;
+
+	const double t = (E - p[a].E)/(p[a + 1].E - p[a].E);
+
+	const size_t open_a = (s_a != NULL? matrix_rows(s_a->re_part) : 0);
+	const size_t open_b = (s_b != NULL? matrix_rows(s_b->re_part) : 0);
+
+	smatrix *s = calloc(1, sizeof(smatrix));
+
+	if (open_a == max_open && open_b == max_open)
+	{
+		s->re_part = matrix_alloc(max_open, max_open, false);
+		s->im_part = matrix_alloc(max_open, max_open, false);
+
+		matrix_add(1.0 - t, s_a->re_part, t, s_b->re_part, s->re_part);
+		matrix_add(1.0 - t, s_a->im_part, t, s_b->im_part, s->im_part);
+
+		return s;
+	}
+
+	const smatrix *nearest = NULL;
+
+	if (open_a == max_open)
+		nearest = s_a;
+	else if (open_b == max_open)
+		nearest = s_b;
+	else
+		nearest = (t < 0.5? s_a : s_b);
+
+	if (nearest == NULL)
+	{
+		free(s);
+		return NULL;
+	}
+
+	s->re_part = matrix_alloc_as(nearest->re_part, false);
+	s->im_part = matrix_alloc_as(nearest->im_part, false);
+
+	matrix_copy(s->re_part, nearest->re_part, 1.0, 0.0);
+	matrix_copy(s->im_part, nearest->im_part, 1.0, 0.0);
+
+	return s;
+}
+
+/******************************************************************************
+
+ Function smatrix_free(): frees an S matrix, if any.
+
+******************************************************************************/
+
+void smatrix_free(smatrix *s)
+{
+	if (s == NULL) return;
+
+	matrix_free(s->re_part);
+	matrix_free(s->im_part);
+	free(s);
+}
+
+/******************************************************************************
+
+ Function csection_change(): interpolates, from the grid p of max_point energies,
+ the S matrices on the uniform output grid of out_grid_size energies in [E_min,
+ E_max) and returns the largest change of the partial cross sections there with
+ respect to the ones of the previous round, sigma[], which are then updated.
+ For each pair of open channels i and f, they are taken in units of pi(2J +
+ 1)/k_i^2, i.e. as |delta_if - S_if|^2, which does not change the convergence
+ at a fixed energy. It returns INF if any energy has no previous value or a
+ different number of open channels.
+
+******************************************************************************/
+
+double csection_change(const size_t max_point,
+                       const struct point p[],
+                       const size_t max_channel,
+                       const double level[],
+                       const size_t out_grid_size,
+                       const double E_min,
+                       const double E_max,
+                       matrix *sigma[])
+{
+	double result = 0.0;
+
+	for (size_t n = 0; n < out_grid_size; ++n)
+	{
+		const double E = E_min + as_double(n)*(E_max - E_min)/as_double(out_grid_size);
+
+		size_t max_open = 0;
+		for (size_t c = 0; c < max_channel; ++c)
+			if (level[c] < E) ++max_open;
+
+		smatrix *s = interp_smatrix(max_point, p, max_open, E);
+
+		if (s == NULL) continue;
+
+		const size_t open = matrix_rows(s->re_part);
+
+		matrix *new_sigma = matrix_alloc(open, open, false);
+
+		for (size_t i = 0; i < open; ++i)
+		{
+			for (size_t f = 0; f < open; ++f)
+			{
+				const double re = (i == f? 1.0 : 0.0) - matrix_get(s->re_part, i, f);
+				const double im = matrix_get(s->im_part, i, f);
+
+				matrix_set(new_sigma, i, f, re*re + im*im);
+			}
+		}
+
+		if (sigma[n] == NULL || matrix_rows(sigma[n]) != open)
+		{
+			result = INF;
+		}
+		else
+		{
+			for (size_t i = 0; i < open; ++i)
+				for (size_t f = 0; f < open; ++f)
+					result = fmax(result, fabs(matrix_get(new_sigma, i, f) - matrix_get(sigma[n], i, f)));
+		}
+
+		if (sigma[n] != NULL) matrix_free(sigma[n]);
+		sigma[n] = new_sigma;
+
+		smatrix_free(s);
+	}
+
+	return result;
+}
+
+/******************************************************************************
+
+ Function compare_point(): compares two points by energy, for qsort().
+
+******************************************************************************/
+
+int compare_point(const void *a, const void *b)
+{
+	const struct point *x = (const struct point *) a;
+	const struct point *y = (const struct point *) b;
+
+	return (x->E > y->E) - (x->E < y->E);
+}
+
+/******************************************************************************
+******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+	mpi_init(argc, argv);
+
+	file_init_stdin(argv[1]);
+
+/*
+ *	Arrangement (a = 1, b = 2, c = 3) and atomic masses:
+ */
+
+	const char arrang = 96 + read_int_keyword(stdin, "arrang", 1, 3, 1);
+
+	pes_init_mass(stdin, 'a');
+	pes_init_mass(stdin, 'b');
+	pes_init_mass(stdin, 'c');
+
+	const double mass = pes_mass_abc(arrang);
+
+/*
+ *	Total angular momentum, J:
+ */
+
+	const size_t J = read_int_keyword(stdin, "J", 0, 10000, 0);
+
+/*
+ *	Total energy: a coarse grid of coll_grid_size intervals in [E_min, E_max] is
+ *	computed first. At each round, every interval flagged is bisected and its
+ *	middle energy propagated. Both halves are flagged again if the S matrix there
+ *	differs from the one interpolated by more than adapt_tol, and each half if
+ *	the sum of eigenphases changes by more than delay_tol along it (a large time
+ *	delay, as near resonances). Intervals are not bisected below adapt_min_step. Rounds
+ *	stop once no interval is flagged, after adapt_max_round rounds or once the
+ *	cross sections are converged, see below:
+ */
+
+	const size_t coll_grid_size = read_int_keyword(stdin, "coll_grid_size", 1, 1000000, 100);
+
+	const double E_min = read_dbl_keyword(stdin, "E_min", -INF, INF, 0.0);
+
+	const double E_max = read_dbl_keyword(stdin, "E_max", E_min, INF, E_min);
+
+	const double E_step = (E_max - E_min)/as_double(coll_grid_size);
+
+	const double adapt_tol = read_dbl_keyword(stdin, "adapt_tol", 0.0, 1.0, 1.0E-3);
+
+	const double delay_tol = read_dbl_keyword(stdin, "delay_tol", 0.0, INF, M_PI/8.0);
+
+	const double min_step = read_dbl_keyword(stdin, "adapt_min_step", 0.0, INF, E_step/1024.0);
+
+	const size_t max_round = read_int_keyword(stdin, "adapt_max_round", 0, 1000, 10);
+
+/*
+ *	Output: S matrices of open channels on a uniform grid of out_grid_size
+ *	energies, E_min + n*(E_max - E_min)/out_grid_size, interpolated from the ones
+ *	computed (the same convention of numerov with save_smatrix = 1):
+ */
+
+	const size_t out_grid_size = read_int_keyword(stdin, "out_grid_size", 1, 1000000, coll_grid_size);
+
+/*
+ *	Cross sections are converged once the partial cross sections of all pairs of
+ *	open channels on the output grid, |delta_if - S_if|^2 in units of pi(2J +
+ *	1)/k_i^2, change by less than csection_tol between two rounds, see csection_
+ *	change(). Thus, csection_tol = 0 turns it off:
+ */
+
+	const double csection_tol = read_dbl_keyword(stdin, "csection_tol", 0.0, 4.0, 1.0E-3);
+
+/*
+ *	Scattering grid (the same used for multipoles and coupling matrices):
+ */
+
+	const size_t scatt_grid_size = read_int_keyword(stdin, "scatt_grid_size", 1, 1000000, 500);
+
+	const double R_min = read_dbl_keyword(stdin, "R_min", 0.0, INF, 0.5);
+
+	const double R_max = read_dbl_keyword(stdin, "R_max", R_min, INF, R_min + 30.0);
+
+	const double R_step = (R_max - R_min)/as_double(scatt_grid_size);
+
+/*
+ *	Directories to read the basis functions from and to store K and S matrices:
+ */
+
+	char *b_dir = read_str_keyword(stdin, "basis_dir", ".");
+
+	char *r_dir = read_str_keyword(stdin, "ratio_dir", ".");
+
+	const bool use_omp = (bool) read_int_keyword(stdin, "use_omp", 0, 1, 0);
+
+/*
+ *	Asymptotic energy and angular momentum of each channel, from the basis:
+ */
+
+	const size_t max_channel = fgh_basis_count(b_dir, arrang, J);
+
+	ASSERT(max_channel > 0)
+
+	int *l = allocate(max_channel, sizeof(int), false);
+	double *level = allocate(max_channel, sizeof(double), false);
+
+	fgh_basis_channels(b_dir, arrang, J, max_channel, l, NULL, level);
+
+	if (mpi_rank() == 0)
+	{
+		printf("# MPI CPUs = %zu, OpenMP threads = %d, num. of channels = %zu\n",
+		       mpi_comm_size(), max_threads(), max_channel);
+	}
+
+/*
+ *	Coarse grid (round 0), including both E_min and E_max:
+ */
+
+	size_t max_point = coll_grid_size + 1;
+
+	struct point *p = allocate(max_point, sizeof(struct point), true);
+
+	double *energy = allocate(max_point, sizeof(double), false);
+	matrix **k = allocate(max_point, sizeof(matrix *), false);
+
+	johnson_workspace *work = johnson_workspace_alloc(max_channel);
+
+	for (size_t n = 0; n < max_point; ++n)
+		energy[n] = E_min + as_double(n)*E_step;
+
+	double start_time = wall_time();
+
+	propagate(arrang, J, scatt_grid_size, R_min, R_step, mass, max_channel, l,
+	          level, max_point, energy, r_dir, k, use_omp);
+
+	for (size_t n = 0; n < max_point; ++n)
+	{
+		p[n].E = energy[n];
+		p[n].k = k[n];
+		p[n].s = johnson_open_smatrix(k[n], level, energy[n], work);
+		p[n].phase = eigenphase_sum(k[n], level, energy[n]);
+		p[n].refine = (n + 1 < max_point);
+	}
+
+	if (mpi_rank() == 0)
+		printf(FORMAT, (size_t) 0, max_point, max_point, 0.0, INF, wall_time() - start_time);
+
+	matrix **sigma = allocate(out_grid_size, sizeof(matrix *), true);
+
+	csection_change(max_point, p, max_channel, level, out_grid_size, E_min, E_max, sigma);
+
+/*
+ *	Refinement rounds:
+ */
+
+	for (size_t cycle = 1; cycle <= max_round; ++cycle)
+	{
+		size_t max_new = 0;
+
+		for (size_t n = 0; (n + 1) < max_point; ++n)
+		{
+			if (p[n].refine && 0.5*(p[n + 1].E - p[n].E) < min_step) p[n].refine = false;
+			if (p[n].refine) ++max_new;
+		}
+
+		if (max_new == 0) break;
+
+		energy = realloc(energy, max_new*sizeof(double));
+		k = realloc(k, max_new*sizeof(matrix *));
+
+		size_t counter = 0;
+		for (size_t n = 0; (n + 1) < max_point; ++n)
+		{
+			if (!p[n].refine) continue;
+
+			energy[counter] = 0.5*(p[n].E + p[n + 1].E);
+			++counter;
+		}
+
+		start_time = wall_time();
+
+		propagate(arrang, J, scatt_grid_size, R_min, R_step, mass, max_channel, l,
+		          level, max_new, energy, r_dir, k, use_omp);
+
+/*
+ *		NOTE: each new energy m is tested against its neighbours a and b, which
+ *		are kept sorted, flagging the intervals [a, m] and [m, b] if needed. The
+ *		eigenphase sum of each half is tested on its own, since a resonance
+ *		inside [a, b] changes the sum along it by about pi, i.e. about zero.
+ */
+
+		p = realloc(p, (max_point + max_new)*sizeof(struct point));
+
+		double max_error = 0.0;
+
+		counter = 0;
+		const size_t old_max_point = max_point;
+
+		for (size_t n = 0; (n + 1) < old_max_point; ++n)
+		{
+			if (!p[n].refine) continue;
+
+			struct point *a = &p[n], *b = &p[n + 1], *m = &p[max_point];
+
+			m->E = energy[counter];
+			m->k = k[counter];
+			m->s = johnson_open_smatrix(k[counter], level, energy[counter], work);
+			m->phase = eigenphase_sum(k[counter], level, energy[counter]);
+
+			const double error = interp_error(a->s, m->s, b->s, a->E, m->E, b->E);
+
+			if (error < INF && error > max_error) max_error = error;
+
+			m->refine = (error > adapt_tol || phase_change(m, b) > delay_tol);
+			a->refine = (error > adapt_tol || phase_change(a, m) > delay_tol);
+
+			++max_point;
+			++counter;
+		}
+
+		qsort(p, max_point, sizeof(struct point), compare_point);
+
+		const double change
+			= csection_change(max_point, p, max_channel, level, out_grid_size, E_min, E_max, sigma);
+
+		if (mpi_rank() == 0)
+			printf(FORMAT, cycle, max_new, max_point, max_error, change, wall_time() - start_time);
+
+		if (change < csection_tol) break;
+	}
+
+	for (size_t n = 0; n < out_grid_size; ++n)
+		if (sigma[n] != NULL) matrix_free(sigma[n]);
+
+	free(sigma);
+
+/*
+ *	Output (process 0): list of energies computed and S matrices of the uniform
+ *	grid interpolated from them:
+ */
+
+	if (mpi_rank() == 0)
+	{
+		char filename[MAX_LINE_LENGTH];
+		sprintf(filename, ENERGY_LIST_FILE_FORMAT, r_dir, arrang, J);
+
+		FILE *output = file_open(filename, "w");
+
+		fprintf(output, "#    E (a.u.)\n");
+
+		for (size_t n = 0; n < max_point; ++n)
+			fprintf(output, "% -.15e\n", p[n].E);
+
+		file_close(&output);
+
+		for (size_t n = 0; n < out_grid_size; ++n)
+		{
+			const double E = E_min + as_double(n)*(E_max - E_min)/as_double(out_grid_size);
+
+			size_t max_open = 0;
+			for (size_t c = 0; c < max_channel; ++c)
+				if (level[c] < E) ++max_open;
+
+			smatrix *s = interp_smatrix(max_point, p, max_open, E);
+
+			if (s == NULL) continue;
+
+			sprintf(filename, S_MATRIX_FILE_FORMAT, r_dir, "re", arrang, n, J);
+			matrix_save(s->re_part, filename);
+
+			sprintf(filename, S_MATRIX_FILE_FORMAT, r_dir, "im", arrang, n, J);
+			matrix_save(s->im_part, filename);
+
+			smatrix_free(s);
+		}
+	}
+
+	johnson_workspace_free(work);
+
+	for (size_t n = 0; n < max_point; ++n)
+	{
+		matrix_free(p[n].k);
+		smatrix_free(p[n].s);
+	}
+
+	free(p);
+	free(k);
+	free(energy);
+	free(level);
+	free(l);
+	free(r_dir);
+	free(b_dir);
+
+	mpi_end();
+	return EXIT_SUCCESS;
+}
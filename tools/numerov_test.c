@@ -3,6 +3,26 @@
 #include "modules/johnson.h"
 #include "modules/globals.h"
 
+/* NOTE: 4He + 20Ne (atomic units). */
+static const double mass = 6089.0;
+
+/******************************************************************************
+
+ Function olson_smith(): the potential matrix of Ref. [1] at x, without the
+ centrifugal term, as needed by johnson_jcp78_lane_numerov().
+
+******************************************************************************/
+
+static void olson_smith(const double x, matrix *v, void *params)
+{
+	ASSERT(params == NULL)
+
+	matrix_set(v, 0, 0, pes_olson_smith_model(0, 0, x));
+	matrix_set(v, 0, 1, pes_olson_smith_model(0, 1, x));
+	matrix_set(v, 1, 0, pes_olson_smith_model(1, 0, x));
+	matrix_set(v, 1, 1, pes_olson_smith_model(1, 1, x));
+}
+
 int main()
 {
 	matrix_init_gpu();
@@ -15,9 +35,6 @@ int main()
 	/* NOTE: collision energy of 70.9 eV (2.60566 a.u.). */
 	const double coll_energy = 2.60566;
 
-	/* NOTE: 4He + 20Ne (atomic units). */
-	const double mass = 6089.0;
-
 	/* NOTE: list of partial waves used at table I of Ref. [1]. */
 	const double l[] =
 	{
@@ -62,15 +79,27 @@ int main()
 		pes_olson_smith_model(1, 1, x_max)
 	};
 
-	matrix *r = matrix_alloc(2, 2, true);
-	matrix *v = matrix_alloc(2, 2, false);
+/*
+ *	NOTE: each partial wave is a lane of the same sweep over the grid, which
+ *	begins deep enough in its centrifugal barrier, see johnson_wkb_start().
+ */
 
-	printf("#  l      Numerov        Ref. [1]           Error\n");
-	printf("# -----------------------------------------------\n");
+	int l_list[28];
+	double energy[14];
+	size_t start[14];
+	matrix *r[14];
+
+	double *diag = allocate(2*grid_size, sizeof(double), false);
+
+	size_t steps = 0;
 
 	for (size_t m = 0; m < 14; ++m)
 	{
-		const int l_list[] = {(int) l[m], (int) l[m]};
+		l_list[2*m] = (int) l[m];
+		l_list[2*m + 1] = (int) l[m];
+
+		energy[m] = coll_energy;
+		r[m] = matrix_alloc(2, 2, true);
 
 		for (size_t n = 0; n < grid_size; ++n)
 		{
@@ -78,18 +107,31 @@ int main()
 
 			const double l_term = l[m]*(l[m] + 1.0)/(2.0*mass*x*x);
 
-			matrix_set(v, 0, 0, pes_olson_smith_model(0, 0, x) + l_term);
-			matrix_set(v, 0, 1, pes_olson_smith_model(0, 1, x));
-			matrix_set(v, 1, 0, pes_olson_smith_model(1, 0, x));
-			matrix_set(v, 1, 1, pes_olson_smith_model(1, 1, x) + l_term);
-
-			johnson_jcp78_numerov(x_step, mass, coll_energy, v, r, NULL);
+			diag[2*n] = pes_olson_smith_model(0, 0, x) + l_term;
+			diag[2*n + 1] = pes_olson_smith_model(1, 1, x) + l_term;
 		}
 
+		start[m] = johnson_wkb_start(grid_size, 2, x_step, mass, coll_energy, 20.0, diag);
+
+		steps += grid_size - start[m];
+	}
+
+	free(diag);
+
+	johnson_workspace *work = johnson_workspace_alloc(2);
+
+	johnson_jcp78_lane_numerov(grid_size, x_step, x_min, mass,
+	                           14, energy, l_list, start, NULL, olson_smith, r);
+
+	printf("#  l      Numerov        Ref. [1]           Error\n");
+	printf("# -----------------------------------------------\n");
+
+	for (size_t m = 0; m < 14; ++m)
+	{
 		matrix *k
-			= johnson_kmatrix(l_list, x_step, coll_energy, mass, levels, r, x_max);
+			= johnson_kmatrix(l_list + 2*m, x_step, coll_energy, mass, levels, r[m], x_max, work);
 
-		smatrix *s = johnson_smatrix(k);
+		smatrix *s = johnson_smatrix(k, work);
 
 		const double s01_real = matrix_get(s->re_part, 0, 1);
 		const double s01_imag = matrix_get(s->im_part, 0, 1);
@@ -100,14 +142,15 @@ int main()
 		matrix_free(s->re_part);
 		matrix_free(s->im_part);
 		matrix_free(k);
+		matrix_free(r[m]);
 		free(s);
 	}
 
 	printf("# -----------------------------------------------\n");
+	printf("# grid points propagated: %zu of %zu\n", steps, 14*grid_size);
 	printf("# [1] B. R. Johnson. Journal of Computational Physics, 13, 445-449 (1973)\n");
 
-	matrix_free(v);
-	matrix_free(r);
+	johnson_workspace_free(work);
 
 	matrix_end_gpu();
 	return EXIT_SUCCESS;